@@ -20,18 +20,31 @@
 #define _DATATYPES_H 1
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef uint32_t addr32_t;
 
+#define NUM_REGISTERS 96
+#define REG_NONE 0xff
+
 typedef enum
 {
 	GENERIC_MODE,
 	JOP_MODE,
 	RET_MODE,
-	SYSCALL_MODE
+	SYSCALL_MODE,
+	DISPATCHER_MODE,
+	COP_MODE,
+	PIVOT_MODE
 } program_mode_t;
 
+typedef enum
+{
+	LINEAR_SCAN,
+	BACKWARD_SCAN
+} scan_strategy_t;
+
 typedef enum
 {
 	LOAD,
@@ -56,13 +69,37 @@ typedef enum
 	IO,
 	MUL,
 	DIV,
+	BITMANIP,
+	MINMAX,
+	CMOV,
+	VLOAD,
+	VSTORE,
+	VSETVL,
+	LPAD,
+	SSPUSH,
+	SSPOPCHK,
+	CSR,
+	ERET,
 	UNSUPORTED
 } op_t;
 
+// Flags for arguments.options
+#define OPT_CFI 0x1
+#define OPT_KERNEL 0x2
+#define OPT_OBJDUMP 0x4
+#define OPT_CROSS 0x8
+#define OPT_BRANCH 0x10
+#define OPT_FRAME 0x20
+#define OPT_TRANSFER 0x40
+
 struct arguments
 {
 	char *file;
 	program_mode_t mode;
+	scan_strategy_t scan;
+	uint8_t depth;
+	uint8_t jopDepth;
+	int32_t syscall;
 	uint8_t arg_num;
 	uint8_t options;
 };
@@ -70,13 +107,35 @@ struct arguments
 typedef struct ins32_t
 {
 	addr32_t address;
-	int16_t immediate;
+	uint32_t encoding;
+	int32_t immediate;
 	bool useImmediate;
 	bool isCompressed;
+	bool isPrivileged;
 	op_t operation;
 	char *disassembled;
+	char *prettified;
+	const char *condition;
 	char regToShift[3];
-	char regDest[3];
+	char regDest[5];
+	uint8_t rd;
+	uint8_t rs[3];
 } ins32_t;
 
+// Run of consecutive instructions, the gadget filters walk it backwards
+typedef struct region_t
+{
+	ins32_t **instructions;
+	size_t count;
+	size_t capacity;
+} region_t;
+
+// Addresses where a function starts, sorted once the scan is over
+typedef struct labels_t
+{
+	addr32_t *addresses;
+	size_t count;
+	size_t capacity;
+} labels_t;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DECODER_H
+#define _DECODER_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "datatypes.h"
+
+// Longest text decodeInstruction() can produce, NUL included
+#define MAX_TEXT 64
+
+extern const char *registerNames[NUM_REGISTERS];
+
+uint8_t decodeInstruction(const uint8_t *code, size_t available, addr32_t address, char *text);
+
+uint32_t expandInstruction(uint16_t c);
+
+#endif
@@ -22,14 +22,16 @@
 #include "datatypes.h"
 #include "node.h"
 
-struct ins32_t *preliminary_gadget_list[100];
+extern struct region_t region;
 
-struct node_t *list;
+extern struct labels_t labels;
 
-struct node_t *spDuplicated;
+extern struct trie_t *trie;
 
 uint8_t disassemble(char *elfFile);
 
-uint8_t fillData(struct ins32_t *instruction);
+size_t fillData(struct ins32_t *instruction);
+
+const char *getDisassembled(struct ins32_t *instruction);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _FIELDS_H
+#define _FIELDS_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "datatypes.h"
+
+#define FIELD_BATCH 32
+
+// Instruction words split into their fields, one array per field
+typedef struct fields_t
+{
+	uint32_t word[FIELD_BATCH];
+	uint8_t opcode[FIELD_BATCH];
+	uint8_t rd[FIELD_BATCH];
+	uint8_t funct3[FIELD_BATCH];
+	uint8_t rs1[FIELD_BATCH];
+	uint8_t rs2[FIELD_BATCH];
+	uint8_t funct7[FIELD_BATCH];
+	size_t count;
+} fields_t;
+
+// Fills every field array from the first count words
+void extractFields(struct fields_t *fields);
+
+// Classifies word index the way fillData() would classify its text. Returns
+// false for anything the tables don't cover, which is left untouched
+bool classifyFields(const struct fields_t *fields, size_t index, struct ins32_t *instruction);
+
+#endif
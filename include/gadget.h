@@ -19,28 +19,74 @@
 #ifndef _GADGET_H
 #define _GADGET_H 1
 
-#define MAX_LENGTH 30
+// Instructions a gadget can have, not counting the lw ra of RET gadgets
+#define DEFAULT_DEPTH 30
+#define DEFAULT_JOP_DEPTH 6
+#define MAX_DEPTH 255
+// Smallest addi sp, sp, X that counts as a stack pivot
+#define PIVOT_LIFT 512
+#define MAX_PIVOT 64
+// Bit of an integer register in a mask, x0 and fp registers have none
+#define REG_BIT(reg) (((reg) > 0 && (reg) < 32) ? (1u << (reg)) : 0)
 
 #include <stdint.h>
 
 #include "datatypes.h"
-#include "node.h"
+
+typedef enum {
+  CFI_NONE,
+  CFI_LANDING_PAD,
+  CFI_UNCHECKED_RET,
+  CFI_RET_ENTRY
+} cfi_status_t;
+
+// What a register holds by the end of a gadget
+typedef enum { VALUE_CONSTANT, VALUE_CONTROLLED, VALUE_UNKNOWN } value_t;
+
+// What a backward walk does when it reaches an instruction
+typedef enum { STEP_CONTINUE, STEP_STOP, STEP_START } step_t;
+
+// What a gadget does with the stack, offsets are from sp when it starts.
+// slots[reg] is where a register it loads comes from, slots[1] being the
+// ra slot. moved means sp is also set from something else than addi
+typedef struct frame_t {
+  int32_t delta;
+  int32_t slots[32];
+  uint32_t loaded;
+  bool moved;
+} frame_t;
 
 typedef struct gadget_t {
-  ins32_t *instructions[MAX_LENGTH];
-  uint8_t length;
+  uint16_t length;
+  cfi_status_t cfi;
+  uint32_t written; // registers the gadget writes
+  int32_t delta;    // what its addi sp, sp, X add up to
+  struct transfer_t *transfer;
+  ins32_t *instructions[];
 } gadget_t;
 
+#include "node.h"
+
 extern struct arguments args;
 
-extern ins32_t *preliminary_gadget_list[100];
+extern struct region_t region;
+
+extern struct labels_t labels;
+
+extern struct trie_t *trie;
 
-extern struct node_t *list;
+void processGadgets(size_t lastElement, op_t lastOperation);
 
-extern struct node_t *spDuplicated;
+step_t walkStep(struct ins32_t *instruction);
 
-void processGadgets(uint8_t lastElement, op_t lastOperation);
+uint16_t maxGadgetLength(op_t lastOperation);
+
+bool adjustsSp(struct ins32_t *instruction);
+
+const char *getPrettified(struct ins32_t *instruction);
 
 void printGadget(struct gadget_t *gadget);
 
+int rankDispatchers(const void *a, const void *b);
+
 #endif
\ No newline at end of file
@@ -21,30 +21,38 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "gadget.h"
 
-typedef struct node_t
+// Gadgets as a reverse trie: the children of the root are terminators and
+// every node is the instruction right before its parent. A gadget is the
+// path from its first instruction up to its terminator
+typedef struct trie_t
 {
-	const char *key;
-	struct gadget_t *data;
-	struct node_t *next;
-} node_t;
+	ins32_t *instruction;
+	ins32_t *terminator;
+	struct trie_t *parent;
+	struct trie_t *children;
+	struct trie_t *sibling;
+	struct trie_t *nextGadget;
+	uint16_t depth;
+	cfi_status_t cfi;
+	int32_t delta;
+	struct transfer_t *transfer;
+	bool isGadget;
+} trie_t;
 
-struct node_t *create();
+struct trie_t *createTrie();
 
-struct node_t *insert(struct node_t *list, struct gadget_t *data, const char *key);
+struct trie_t *findPath(struct trie_t *root, struct gadget_t *gadget);
 
-void update(struct node_t *node, struct gadget_t *data, const char *key);
+struct trie_t *findVariant(struct trie_t *node, struct gadget_t *gadget, uint16_t i);
 
-struct gadget_t *delete(struct node_t *list, const char *key);
+struct trie_t *markGadget(struct trie_t *last, struct trie_t *node, struct gadget_t *gadget);
 
-struct node_t *find(struct node_t *list, const char *key);
-
-void printContent(struct node_t *list);
-
-void destroy(struct node_t *list);
+void printContent(struct trie_t *root, int (*rank)(const void *, const void *));
 
 #endif
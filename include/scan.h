@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SCAN_H
+#define _SCAN_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Finds every halfword offset holding a jalr (ret, jr, jalr), c.jr, c.jalr,
+// ecall, sret or mret. Returns how many were found; *candidates gets the
+// offsets in increasing order and must be freed by the caller
+size_t findTerminators(const uint8_t *code, size_t size, uint32_t **candidates);
+
+// Conditional branch at source, taken to target when rs1 <op> rs2. The
+// operation is given by funct3 as in beq/bne/blt/bge/bltu/bgeu
+typedef struct branch_t
+{
+	uint32_t source;
+	uint32_t target;
+	uint8_t rs1;
+	uint8_t rs2;
+	uint8_t funct3;
+} branch_t;
+
+// Decodes the b* or c.beqz/c.bnez at offset, if there is one. Offsets are
+// relative to code, the target may fall outside of it
+bool decodeBranch(const uint8_t *code, size_t offset, size_t size, struct branch_t *branch);
+
+// Finds every halfword offset holding a conditional branch that lands inside
+// the code. Returns how many were found; *branches gets them sorted by
+// target and must be freed by the caller
+size_t findBranches(const uint8_t *code, size_t size, struct branch_t **branches);
+
+#endif
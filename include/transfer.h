@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _TRANSFER_H
+#define _TRANSFER_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "node.h"
+
+// pc goes right after x31 in a transfer_t
+#define TRANSFER_PC 32
+
+typedef enum
+{
+	SYM_UNKNOWN,
+	SYM_CONST,
+	SYM_REG,
+	SYM_MEM,
+	SYM_LINK
+} sym_kind_t;
+
+// What a register holds in terms of the registers at the start: offset,
+// reg + offset or mem[reg + offset] + addend. SYM_LINK is the return
+// address a jalr leaves and SYM_UNKNOWN anything else
+typedef struct sym_t
+{
+	sym_kind_t kind;
+	uint8_t reg;
+	int32_t offset;
+	int32_t addend;
+} sym_t;
+
+// Registers a gadget writes, pc included, and what they end up holding.
+// Memory is read as the gadget found it, a load that may read something
+// the gadget stored is unknown
+typedef struct transfer_t
+{
+	uint64_t written;
+	sym_t values[TRANSFER_PC + 1];
+} transfer_t;
+
+// Transfer of the path from node up to its terminator. It is built from the
+// parent's one and kept in the node, gadgets sharing a tail share the work
+struct transfer_t *transferOf(struct trie_t *root, struct trie_t *node);
+
+void printTransfer(const struct transfer_t *transfer);
+
+#endif
@@ -0,0 +1,964 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "decoder.h"
+
+// Mnemonic gets the .aq/.rl suffix from bits 26:25
+#define FLAG_AQRL 0x1
+// Only matches when rs1 == rs2 (fmv.s, fneg.s, fabs.s)
+#define FLAG_SAME_RS 0x2
+
+#define RD(word) (((word) >> 7) & 0x1f)
+#define RS1(word) (((word) >> 15) & 0x1f)
+#define RS2(word) (((word) >> 20) & 0x1f)
+#define RS3(word) (((word) >> 27) & 0x1f)
+#define FPR(reg) ((reg) + 32)
+
+typedef struct opcode_t
+{
+    const char *name;
+    const char *args;
+    uint32_t match;
+    uint32_t mask;
+    uint8_t flags;
+} opcode_t;
+
+typedef struct csr_t
+{
+    uint16_t number;
+    const char *name;
+} csr_t;
+
+typedef struct writer_t
+{
+    char *buf;
+    size_t pos;
+} writer_t;
+
+// ABI names indexed by register number: x0-x31, f0-f31 and v0-v31
+const char *registerNames[NUM_REGISTERS] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+    "ft0", "ft1", "ft2", "ft3", "ft4", "ft5", "ft6", "ft7",
+    "fs0", "fs1", "fa0", "fa1", "fa2", "fa3", "fa4", "fa5",
+    "fa6", "fa7", "fs2", "fs3", "fs4", "fs5", "fs6", "fs7",
+    "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11",
+    "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+    "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+    "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+    "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31"};
+
+/*
+ * Same conventions as binutils' riscv-opc.c: the first entry that matches
+ * wins, so every pseudo-instruction sits right before the instruction it's
+ * an alias of. Argument letters:
+ *   d s t      rd rs1 rs2 (integer)      D S T R    rd rs1 rs2 rs3 (float)
+ *   j          I-type immediate          q          S-type immediate
+ *   u          U-type immediate (hex)    >          shift amount (hex)
+ *   p a        branch / jump target      E Z        CSR / CSR immediate
+ *   m          rounding mode if not dyn  P Q        fence predecessor / successor
+ *   c b        vtype of vsetvli / vsetivli
+ */
+static const opcode_t opcodes[] = {
+    {"unimp", "", 0xc0001073, 0xffffffff},
+    {"ecall", "", 0x00000073, 0xffffffff},
+    {"ebreak", "", 0x00100073, 0xffffffff},
+    {"sret", "", 0x10200073, 0xffffffff},
+    {"mret", "", 0x30200073, 0xffffffff},
+    {"wfi", "", 0x10500073, 0xffffffff},
+    {"sfence.vma", "", 0x12000073, 0xffffffff},
+    {"sfence.vma", "s", 0x12000073, 0xfff07fff},
+    {"sfence.vma", "s,t", 0x12000073, 0xfe007fff},
+
+    // Jumps
+    {"ret", "", 0x00008067, 0xffffffff},
+    {"jr", "s", 0x00000067, 0xfff07fff},
+    {"jr", "j(s)", 0x00000067, 0x00007fff},
+    {"jalr", "s", 0x000000e7, 0xfff07fff},
+    {"jalr", "j(s)", 0x000000e7, 0x00007fff},
+    {"jalr", "d,s", 0x00000067, 0xfff0707f},
+    {"jalr", "d,j(s)", 0x00000067, 0x0000707f},
+    {"j", "a", 0x0000006f, 0x00000fff},
+    {"jal", "a", 0x000000ef, 0x00000fff},
+    {"jal", "d,a", 0x0000006f, 0x0000007f},
+
+    // Branches
+    {"beqz", "s,p", 0x00000063, 0x01f0707f},
+    {"beq", "s,t,p", 0x00000063, 0x0000707f},
+    {"blez", "t,p", 0x00005063, 0x000ff07f},
+    {"bgez", "s,p", 0x00005063, 0x01f0707f},
+    {"bge", "s,t,p", 0x00005063, 0x0000707f},
+    {"bgeu", "s,t,p", 0x00007063, 0x0000707f},
+    {"bltz", "s,p", 0x00004063, 0x01f0707f},
+    {"bgtz", "t,p", 0x00004063, 0x000ff07f},
+    {"blt", "s,t,p", 0x00004063, 0x0000707f},
+    {"bltu", "s,t,p", 0x00006063, 0x0000707f},
+    {"bnez", "s,p", 0x00001063, 0x01f0707f},
+    {"bne", "s,t,p", 0x00001063, 0x0000707f},
+
+    // Upper immediates. lpad is auipc x0 (Zicfilp)
+    {"lui", "d,u", 0x00000037, 0x0000007f},
+    {"lpad", "u", 0x00000017, 0x00000fff},
+    {"auipc", "d,u", 0x00000017, 0x0000007f},
+
+    // Loads and stores
+    {"lb", "d,j(s)", 0x00000003, 0x0000707f},
+    {"lh", "d,j(s)", 0x00001003, 0x0000707f},
+    {"lw", "d,j(s)", 0x00002003, 0x0000707f},
+    {"lbu", "d,j(s)", 0x00004003, 0x0000707f},
+    {"lhu", "d,j(s)", 0x00005003, 0x0000707f},
+    {"sb", "t,q(s)", 0x00000023, 0x0000707f},
+    {"sh", "t,q(s)", 0x00001023, 0x0000707f},
+    {"sw", "t,q(s)", 0x00002023, 0x0000707f},
+
+    // OP-IMM
+    {"nop", "", 0x00000013, 0xffffffff},
+    {"li", "d,j", 0x00000013, 0x000ff07f},
+    {"mv", "d,s", 0x00000013, 0xfff0707f},
+    {"addi", "d,s,j", 0x00000013, 0x0000707f},
+    {"slti", "d,s,j", 0x00002013, 0x0000707f},
+    {"seqz", "d,s", 0x00103013, 0xfff0707f},
+    {"sltiu", "d,s,j", 0x00003013, 0x0000707f},
+    {"not", "d,s", 0xfff04013, 0xfff0707f},
+    {"xori", "d,s,j", 0x00004013, 0x0000707f},
+    {"ori", "d,s,j", 0x00006013, 0x0000707f},
+    {"zext.b", "d,s", 0x0ff07013, 0xfff0707f},
+    {"andi", "d,s,j", 0x00007013, 0x0000707f},
+    {"clz", "d,s", 0x60001013, 0xfff0707f},
+    {"ctz", "d,s", 0x60101013, 0xfff0707f},
+    {"cpop", "d,s", 0x60201013, 0xfff0707f},
+    {"sext.b", "d,s", 0x60401013, 0xfff0707f},
+    {"sext.h", "d,s", 0x60501013, 0xfff0707f},
+    {"bseti", "d,s,>", 0x28001013, 0xfe00707f},
+    {"bclri", "d,s,>", 0x48001013, 0xfe00707f},
+    {"binvi", "d,s,>", 0x68001013, 0xfe00707f},
+    {"slli", "d,s,>", 0x00001013, 0xfe00707f},
+    {"orc.b", "d,s", 0x28705013, 0xfff0707f},
+    {"rev8", "d,s", 0x69805013, 0xfff0707f},
+    {"rori", "d,s,>", 0x60005013, 0xfe00707f},
+    {"bexti", "d,s,>", 0x48005013, 0xfe00707f},
+    {"srli", "d,s,>", 0x00005013, 0xfe00707f},
+    {"srai", "d,s,>", 0x40005013, 0xfe00707f},
+
+    // OP
+    {"add", "d,s,t", 0x00000033, 0xfe00707f},
+    {"neg", "d,t", 0x40000033, 0xfe0ff07f},
+    {"sub", "d,s,t", 0x40000033, 0xfe00707f},
+    {"sll", "d,s,t", 0x00001033, 0xfe00707f},
+    {"sltz", "d,s", 0x00002033, 0xfff0707f},
+    {"sgtz", "d,t", 0x00002033, 0xfe0ff07f},
+    {"slt", "d,s,t", 0x00002033, 0xfe00707f},
+    {"snez", "d,t", 0x00003033, 0xfe0ff07f},
+    {"sltu", "d,s,t", 0x00003033, 0xfe00707f},
+    {"xor", "d,s,t", 0x00004033, 0xfe00707f},
+    {"srl", "d,s,t", 0x00005033, 0xfe00707f},
+    {"sra", "d,s,t", 0x40005033, 0xfe00707f},
+    {"or", "d,s,t", 0x00006033, 0xfe00707f},
+    {"and", "d,s,t", 0x00007033, 0xfe00707f},
+
+    // M
+    {"mul", "d,s,t", 0x02000033, 0xfe00707f},
+    {"mulh", "d,s,t", 0x02001033, 0xfe00707f},
+    {"mulhsu", "d,s,t", 0x02002033, 0xfe00707f},
+    {"mulhu", "d,s,t", 0x02003033, 0xfe00707f},
+    {"div", "d,s,t", 0x02004033, 0xfe00707f},
+    {"divu", "d,s,t", 0x02005033, 0xfe00707f},
+    {"rem", "d,s,t", 0x02006033, 0xfe00707f},
+    {"remu", "d,s,t", 0x02007033, 0xfe00707f},
+
+    // Zba, Zbb, Zbs, Zbc and Zicond
+    {"sh1add", "d,s,t", 0x20002033, 0xfe00707f},
+    {"sh2add", "d,s,t", 0x20004033, 0xfe00707f},
+    {"sh3add", "d,s,t", 0x20006033, 0xfe00707f},
+    {"andn", "d,s,t", 0x40007033, 0xfe00707f},
+    {"orn", "d,s,t", 0x40006033, 0xfe00707f},
+    {"xnor", "d,s,t", 0x40004033, 0xfe00707f},
+    {"min", "d,s,t", 0x0a004033, 0xfe00707f},
+    {"minu", "d,s,t", 0x0a005033, 0xfe00707f},
+    {"max", "d,s,t", 0x0a006033, 0xfe00707f},
+    {"maxu", "d,s,t", 0x0a007033, 0xfe00707f},
+    {"zext.h", "d,s", 0x08004033, 0xfff0707f},
+    {"rol", "d,s,t", 0x60001033, 0xfe00707f},
+    {"ror", "d,s,t", 0x60005033, 0xfe00707f},
+    {"bclr", "d,s,t", 0x48001033, 0xfe00707f},
+    {"bext", "d,s,t", 0x48005033, 0xfe00707f},
+    {"binv", "d,s,t", 0x68001033, 0xfe00707f},
+    {"bset", "d,s,t", 0x28001033, 0xfe00707f},
+    {"clmul", "d,s,t", 0x0a001033, 0xfe00707f},
+    {"clmulr", "d,s,t", 0x0a002033, 0xfe00707f},
+    {"clmulh", "d,s,t", 0x0a003033, 0xfe00707f},
+    {"czero.eqz", "d,s,t", 0x0e005033, 0xfe00707f},
+    {"czero.nez", "d,s,t", 0x0e007033, 0xfe00707f},
+
+    // Fences
+    {"fence", "", 0x0ff0000f, 0xffffffff},
+    {"fence.tso", "", 0x8330000f, 0xffffffff},
+    {"pause", "", 0x0100000f, 0xffffffff},
+    {"fence", "P,Q", 0x0000000f, 0xf00fffff},
+    {"fence.i", "", 0x0000100f, 0xffffffff},
+
+    // Zicfiss
+    {"sspush", "t", 0xce104073, 0xffffffff},
+    {"sspush", "t", 0xce504073, 0xffffffff},
+    {"sspopchk", "s", 0xcdc0c073, 0xffffffff},
+    {"sspopchk", "s", 0xcdc2c073, 0xffffffff},
+    {"ssrdp", "d", 0xcdc04073, 0xfffff07f},
+    {"ssamoswap.w", "d,t,(s)", 0x4800202f, 0xf800707f, FLAG_AQRL},
+
+    // Zicsr. Counter and FP CSR pseudos first, then the generic ones
+    {"rdcycle", "d", 0xc0002073, 0xfffff07f},
+    {"rdtime", "d", 0xc0102073, 0xfffff07f},
+    {"rdinstret", "d", 0xc0202073, 0xfffff07f},
+    {"rdcycleh", "d", 0xc8002073, 0xfffff07f},
+    {"rdtimeh", "d", 0xc8102073, 0xfffff07f},
+    {"rdinstreth", "d", 0xc8202073, 0xfffff07f},
+    {"frcsr", "d", 0x00302073, 0xfffff07f},
+    {"fscsr", "s", 0x00301073, 0xfff07fff},
+    {"fscsr", "d,s", 0x00301073, 0xfff0707f},
+    {"frrm", "d", 0x00202073, 0xfffff07f},
+    {"fsrm", "s", 0x00201073, 0xfff07fff},
+    {"fsrm", "d,s", 0x00201073, 0xfff0707f},
+    {"fsrmi", "Z", 0x00205073, 0xfff07fff},
+    {"fsrmi", "d,Z", 0x00205073, 0xfff0707f},
+    {"frflags", "d", 0x00102073, 0xfffff07f},
+    {"fsflags", "s", 0x00101073, 0xfff07fff},
+    {"fsflags", "d,s", 0x00101073, 0xfff0707f},
+    {"fsflagsi", "Z", 0x00105073, 0xfff07fff},
+    {"fsflagsi", "d,Z", 0x00105073, 0xfff0707f},
+    {"csrr", "d,E", 0x00002073, 0x000ff07f},
+    {"csrw", "E,s", 0x00001073, 0x00007fff},
+    {"csrs", "E,s", 0x00002073, 0x00007fff},
+    {"csrc", "E,s", 0x00003073, 0x00007fff},
+    {"csrwi", "E,Z", 0x00005073, 0x00007fff},
+    {"csrsi", "E,Z", 0x00006073, 0x00007fff},
+    {"csrci", "E,Z", 0x00007073, 0x00007fff},
+    {"csrrw", "d,E,s", 0x00001073, 0x0000707f},
+    {"csrrs", "d,E,s", 0x00002073, 0x0000707f},
+    {"csrrc", "d,E,s", 0x00003073, 0x0000707f},
+    {"csrrwi", "d,E,Z", 0x00005073, 0x0000707f},
+    {"csrrsi", "d,E,Z", 0x00006073, 0x0000707f},
+    {"csrrci", "d,E,Z", 0x00007073, 0x0000707f},
+
+    // A
+    {"lr.w", "d,(s)", 0x1000202f, 0xf9f0707f, FLAG_AQRL},
+    {"sc.w", "d,t,(s)", 0x1800202f, 0xf800707f, FLAG_AQRL},
+    {"amoswap.w", "d,t,(s)", 0x0800202f, 0xf800707f, FLAG_AQRL},
+    {"amoadd.w", "d,t,(s)", 0x0000202f, 0xf800707f, FLAG_AQRL},
+    {"amoxor.w", "d,t,(s)", 0x2000202f, 0xf800707f, FLAG_AQRL},
+    {"amoand.w", "d,t,(s)", 0x6000202f, 0xf800707f, FLAG_AQRL},
+    {"amoor.w", "d,t,(s)", 0x4000202f, 0xf800707f, FLAG_AQRL},
+    {"amomin.w", "d,t,(s)", 0x8000202f, 0xf800707f, FLAG_AQRL},
+    {"amomax.w", "d,t,(s)", 0xa000202f, 0xf800707f, FLAG_AQRL},
+    {"amominu.w", "d,t,(s)", 0xc000202f, 0xf800707f, FLAG_AQRL},
+    {"amomaxu.w", "d,t,(s)", 0xe000202f, 0xf800707f, FLAG_AQRL},
+
+    // F
+    {"flw", "D,j(s)", 0x00002007, 0x0000707f},
+    {"fsw", "T,q(s)", 0x00002027, 0x0000707f},
+    {"fmadd.s", "D,S,T,Rm", 0x00000043, 0x0600007f},
+    {"fmsub.s", "D,S,T,Rm", 0x00000047, 0x0600007f},
+    {"fnmsub.s", "D,S,T,Rm", 0x0000004b, 0x0600007f},
+    {"fnmadd.s", "D,S,T,Rm", 0x0000004f, 0x0600007f},
+    {"fadd.s", "D,S,Tm", 0x00000053, 0xfe00007f},
+    {"fsub.s", "D,S,Tm", 0x08000053, 0xfe00007f},
+    {"fmul.s", "D,S,Tm", 0x10000053, 0xfe00007f},
+    {"fdiv.s", "D,S,Tm", 0x18000053, 0xfe00007f},
+    {"fsqrt.s", "D,Sm", 0x58000053, 0xfff0007f},
+    {"fmv.s", "D,S", 0x20000053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnj.s", "D,S,T", 0x20000053, 0xfe00707f},
+    {"fneg.s", "D,S", 0x20001053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnjn.s", "D,S,T", 0x20001053, 0xfe00707f},
+    {"fabs.s", "D,S", 0x20002053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnjx.s", "D,S,T", 0x20002053, 0xfe00707f},
+    {"fmin.s", "D,S,T", 0x28000053, 0xfe00707f},
+    {"fmax.s", "D,S,T", 0x28001053, 0xfe00707f},
+    {"fcvt.w.s", "d,Sm", 0xc0000053, 0xfff0007f},
+    {"fcvt.wu.s", "d,Sm", 0xc0100053, 0xfff0007f},
+    {"fmv.x.w", "d,S", 0xe0000053, 0xfff0707f},
+    {"fclass.s", "d,S", 0xe0001053, 0xfff0707f},
+    {"feq.s", "d,S,T", 0xa0002053, 0xfe00707f},
+    {"flt.s", "d,S,T", 0xa0001053, 0xfe00707f},
+    {"fle.s", "d,S,T", 0xa0000053, 0xfe00707f},
+    {"fcvt.s.w", "D,sm", 0xd0000053, 0xfff0007f},
+    {"fcvt.s.wu", "D,sm", 0xd0100053, 0xfff0007f},
+    {"fmv.w.x", "D,s", 0xf0000053, 0xfff0707f},
+
+    // D
+    {"fld", "D,j(s)", 0x00003007, 0x0000707f},
+    {"fsd", "T,q(s)", 0x00003027, 0x0000707f},
+    {"fmadd.d", "D,S,T,Rm", 0x02000043, 0x0600007f},
+    {"fmsub.d", "D,S,T,Rm", 0x02000047, 0x0600007f},
+    {"fnmsub.d", "D,S,T,Rm", 0x0200004b, 0x0600007f},
+    {"fnmadd.d", "D,S,T,Rm", 0x0200004f, 0x0600007f},
+    {"fadd.d", "D,S,Tm", 0x02000053, 0xfe00007f},
+    {"fsub.d", "D,S,Tm", 0x0a000053, 0xfe00007f},
+    {"fmul.d", "D,S,Tm", 0x12000053, 0xfe00007f},
+    {"fdiv.d", "D,S,Tm", 0x1a000053, 0xfe00007f},
+    {"fsqrt.d", "D,Sm", 0x5a000053, 0xfff0007f},
+    {"fmv.d", "D,S", 0x22000053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnj.d", "D,S,T", 0x22000053, 0xfe00707f},
+    {"fneg.d", "D,S", 0x22001053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnjn.d", "D,S,T", 0x22001053, 0xfe00707f},
+    {"fabs.d", "D,S", 0x22002053, 0xfe00707f, FLAG_SAME_RS},
+    {"fsgnjx.d", "D,S,T", 0x22002053, 0xfe00707f},
+    {"fmin.d", "D,S,T", 0x2a000053, 0xfe00707f},
+    {"fmax.d", "D,S,T", 0x2a001053, 0xfe00707f},
+    {"fcvt.s.d", "D,Sm", 0x40100053, 0xfff0007f},
+    {"fcvt.d.s", "D,S", 0x42000053, 0xfff0007f},
+    {"feq.d", "d,S,T", 0xa2002053, 0xfe00707f},
+    {"flt.d", "d,S,T", 0xa2001053, 0xfe00707f},
+    {"fle.d", "d,S,T", 0xa2000053, 0xfe00707f},
+    {"fclass.d", "d,S", 0xe2001053, 0xfff0707f},
+    {"fcvt.w.d", "d,Sm", 0xc2000053, 0xfff0007f},
+    {"fcvt.wu.d", "d,Sm", 0xc2100053, 0xfff0007f},
+    {"fcvt.d.w", "D,s", 0xd2000053, 0xfff0007f},
+    {"fcvt.d.wu", "D,s", 0xd2100053, 0xfff0007f},
+
+    // V configuration. Memory accesses are decoded by decodeVectorMemory()
+    {"vsetvli", "d,s,c", 0x00007057, 0x8000707f},
+    {"vsetivli", "d,Z,b", 0xc0007057, 0xc000707f},
+    {"vsetvl", "d,s,t", 0x80007057, 0xfe00707f},
+    {NULL, NULL, 0, 0}};
+
+static const csr_t csrs[] = {
+    {0x001, "fflags"}, {0x002, "frm"}, {0x003, "fcsr"}, {0x008, "vstart"},
+    {0x009, "vxsat"}, {0x00a, "vxrm"}, {0x00f, "vcsr"}, {0x011, "ssp"},
+    {0x015, "seed"}, {0x017, "jvt"}, {0xc00, "cycle"}, {0xc01, "time"},
+    {0xc02, "instret"}, {0xc20, "vl"}, {0xc21, "vtype"}, {0xc22, "vlenb"},
+    {0xc80, "cycleh"}, {0xc81, "timeh"}, {0xc82, "instreth"},
+    {0x100, "sstatus"}, {0x104, "sie"}, {0x105, "stvec"}, {0x106, "scounteren"},
+    {0x10a, "senvcfg"}, {0x140, "sscratch"}, {0x141, "sepc"}, {0x142, "scause"},
+    {0x143, "stval"}, {0x144, "sip"}, {0x14d, "stimecmp"}, {0x180, "satp"},
+    {0x300, "mstatus"}, {0x301, "misa"}, {0x302, "medeleg"}, {0x303, "mideleg"},
+    {0x304, "mie"}, {0x305, "mtvec"}, {0x306, "mcounteren"}, {0x30a, "menvcfg"},
+    {0x310, "mstatush"}, {0x320, "mcountinhibit"}, {0x340, "mscratch"},
+    {0x341, "mepc"}, {0x342, "mcause"}, {0x343, "mtval"}, {0x344, "mip"},
+    {0x3a0, "pmpcfg0"}, {0x3a1, "pmpcfg1"}, {0x3a2, "pmpcfg2"}, {0x3a3, "pmpcfg3"},
+    {0x7a0, "tselect"}, {0x7a1, "tdata1"}, {0x7a2, "tdata2"}, {0x7a3, "tdata3"},
+    {0x7b0, "dcsr"}, {0x7b1, "dpc"}, {0x7b2, "dscratch0"}, {0x7b3, "dscratch1"},
+    {0xb00, "mcycle"}, {0xb02, "minstret"}, {0xb80, "mcycleh"}, {0xb82, "minstreth"},
+    {0xf11, "mvendorid"}, {0xf12, "marchid"}, {0xf13, "mimpid"}, {0xf14, "mhartid"},
+    {0xf15, "mconfigptr"}, {0, NULL}};
+
+static const char *roundingModes[] = {"rne", "rtz", "rdn", "rup", "rmm", NULL, NULL, "dyn"};
+
+static const char *vectorLmul[] = {"m1", "m2", "m4", "m8", NULL, "mf8", "mf4", "mf2"};
+
+static void put(struct writer_t *writer, const char *format, ...);
+
+static void printCsr(struct writer_t *writer, uint16_t csr);
+
+static void printVtype(struct writer_t *writer, uint32_t vtype, uint32_t reserved);
+
+static void printArgs(struct writer_t *writer, const char *args, uint32_t word, addr32_t address);
+
+static bool decodeVectorMemory(uint32_t word, struct writer_t *writer);
+
+static bool decodeCompressedHint(uint16_t c, struct writer_t *writer);
+
+static uint32_t expandCompressed(uint16_t c);
+
+static __attribute__((always_inline)) inline int32_t signExtend(uint32_t value, uint8_t bits);
+
+static __attribute__((always_inline)) inline uint32_t itype(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm);
+
+static __attribute__((always_inline)) inline uint32_t stype(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+
+static __attribute__((always_inline)) inline uint32_t rtype(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2);
+
+static __attribute__((always_inline)) inline uint32_t btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+
+static __attribute__((always_inline)) inline uint32_t jtype(uint32_t rd, int32_t imm);
+
+static inline int32_t signExtend(uint32_t value, uint8_t bits)
+{
+    return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+static inline uint32_t itype(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm)
+{
+    return ((uint32_t)imm << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static inline uint32_t stype(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    return (((uint32_t)imm >> 5 & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (funct3 << 12) | ((imm & 0x1f) << 7) | opcode;
+}
+
+static inline uint32_t rtype(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2)
+{
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static inline uint32_t btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    return ((imm >> 12 & 0x1) << 31) | ((imm >> 5 & 0x3f) << 25) | (rs2 << 20) |
+           (rs1 << 15) | (funct3 << 12) | ((imm >> 1 & 0xf) << 8) |
+           ((imm >> 11 & 0x1) << 7) | 0x63;
+}
+
+static inline uint32_t jtype(uint32_t rd, int32_t imm)
+{
+    return ((imm >> 20 & 0x1) << 31) | ((imm >> 1 & 0x3ff) << 21) |
+           ((imm >> 11 & 0x1) << 20) | ((imm >> 12 & 0xff) << 12) | (rd << 7) | 0x6f;
+}
+
+static void put(struct writer_t *writer, const char *format, ...)
+{
+    va_list ap;
+    int written;
+
+    va_start(ap, format);
+    written = vsnprintf(&writer->buf[writer->pos], MAX_TEXT - writer->pos, format, ap);
+    va_end(ap);
+
+    if (written > 0)
+    {
+        writer->pos += written;
+        if (writer->pos >= MAX_TEXT)
+        {
+            writer->pos = MAX_TEXT - 1;
+        }
+    }
+}
+
+static void printCsr(struct writer_t *writer, uint16_t csr)
+{
+    const csr_t *entry;
+
+    for (entry = csrs; entry->name; entry++)
+    {
+        if (entry->number == csr)
+        {
+            put(writer, "%s", entry->name);
+            return;
+        }
+    }
+
+    if (csr >= 0xc03 && csr <= 0xc1f)
+    {
+        put(writer, "hpmcounter%d", csr - 0xc00);
+    }
+
+    else if (csr >= 0x3b0 && csr <= 0x3bf)
+    {
+        put(writer, "pmpaddr%d", csr - 0x3b0);
+    }
+
+    else
+    {
+        put(writer, "0x%x", csr);
+    }
+}
+
+static void printVtype(struct writer_t *writer, uint32_t vtype, uint32_t reserved)
+{
+    uint32_t sew = (vtype >> 3) & 0x7, lmul = vtype & 0x7;
+
+    if ((vtype & reserved) || sew > 3 || !vectorLmul[lmul])
+    {
+        put(writer, "%u", vtype);
+        return;
+    }
+    put(writer, "e%d,%s,%s,%s", 8 << sew, vectorLmul[lmul],
+        (vtype & 0x40) ? "ta" : "tu", (vtype & 0x80) ? "ma" : "mu");
+}
+
+static void printArgs(struct writer_t *writer, const char *args, uint32_t word, addr32_t address)
+{
+    int32_t imm;
+
+    for (; *args; args++)
+    {
+        switch (*args)
+        {
+        case 'd':
+            put(writer, "%s", registerNames[RD(word)]);
+            break;
+        case 's':
+            put(writer, "%s", registerNames[RS1(word)]);
+            break;
+        case 't':
+            put(writer, "%s", registerNames[RS2(word)]);
+            break;
+        case 'D':
+            put(writer, "%s", registerNames[FPR(RD(word))]);
+            break;
+        case 'S':
+            put(writer, "%s", registerNames[FPR(RS1(word))]);
+            break;
+        case 'T':
+            put(writer, "%s", registerNames[FPR(RS2(word))]);
+            break;
+        case 'R':
+            put(writer, "%s", registerNames[FPR(RS3(word))]);
+            break;
+        case 'j':
+            put(writer, "%d", (int32_t)word >> 20);
+            break;
+        case 'q':
+            put(writer, "%d", ((int32_t)word >> 25 << 5) | RD(word));
+            break;
+        case 'u':
+            put(writer, "0x%x", word >> 12);
+            break;
+        case '>':
+            put(writer, "0x%x", RS2(word));
+            break;
+        case 'p':
+            imm = signExtend(((word >> 31) << 12) | (((word >> 7) & 0x1) << 11) |
+                                 (((word >> 25) & 0x3f) << 5) | (((word >> 8) & 0xf) << 1),
+                             13);
+            put(writer, "%x", address + imm);
+            break;
+        case 'a':
+            imm = signExtend(((word >> 31) << 20) | (((word >> 12) & 0xff) << 12) |
+                                 (((word >> 20) & 0x1) << 11) | (((word >> 21) & 0x3ff) << 1),
+                             21);
+            put(writer, "%x", address + imm);
+            break;
+        case 'E':
+            printCsr(writer, word >> 20);
+            break;
+        case 'Z':
+            put(writer, "%d", RS1(word));
+            break;
+        case 'm':
+            if (7 != ((word >> 12) & 0x7))
+            {
+                if (roundingModes[(word >> 12) & 0x7])
+                {
+                    put(writer, ",%s", roundingModes[(word >> 12) & 0x7]);
+                }
+
+                else
+                {
+                    put(writer, ",%d", (word >> 12) & 0x7);
+                }
+            }
+            break;
+        case 'P':
+        case 'Q':
+            imm = (word >> ('P' == *args ? 24 : 20)) & 0xf;
+            if (!imm)
+            {
+                put(writer, "0");
+            }
+            put(writer, "%s%s%s%s", (imm & 0x8) ? "i" : "", (imm & 0x4) ? "o" : "",
+                (imm & 0x2) ? "r" : "", (imm & 0x1) ? "w" : "");
+            break;
+        case 'c':
+            printVtype(writer, (word >> 20) & 0x7ff, 0x700);
+            break;
+        case 'b':
+            printVtype(writer, (word >> 20) & 0x3ff, 0x300);
+            break;
+        default:
+            put(writer, "%c", *args);
+            break;
+        }
+    }
+}
+
+// Unit-stride, strided and indexed vector loads/stores (LOAD-FP/STORE-FP)
+static bool decodeVectorMemory(uint32_t word, struct writer_t *writer)
+{
+    uint32_t width = (word >> 12) & 0x7, mop = (word >> 26) & 0x3;
+    uint32_t nf = ((word >> 29) & 0x7) + 1, umop = RS2(word);
+    bool isLoad = 0x07 == (word & 0x7f), masked = !((word >> 25) & 0x1);
+    const char *prefix = isLoad ? "vl" : "vs";
+    uint32_t eew;
+
+    if ((width && width < 5) || ((word >> 28) & 0x1))
+    {
+        return false;
+    }
+    eew = width ? 1 << (width - 1) : 8;
+
+    switch (mop)
+    {
+    case 0:
+        // Whole register and mask forms are never masked, the rest of
+        // their bits are fixed too
+        if ((0x08 == umop || 0x0b == umop) && masked)
+        {
+            return false;
+        }
+
+        if (0x08 == umop)
+        {
+            if ((nf & (nf - 1)) || (!isLoad && width))
+            {
+                return false;
+            }
+
+            // Whole register: no mask, no vl
+            if (isLoad)
+            {
+                put(writer, "vl%dre%d.v\tv%d,(%s)", nf, eew, RD(word), registerNames[RS1(word)]);
+            }
+
+            else
+            {
+                put(writer, "vs%dr.v\tv%d,(%s)", nf, RD(word), registerNames[RS1(word)]);
+            }
+            return true;
+        }
+
+        else if (0x0b == umop)
+        {
+            if (1 != nf || width)
+            {
+                return false;
+            }
+
+            put(writer, "%sm.v\tv%d,(%s)", prefix, RD(word), registerNames[RS1(word)]);
+            return true;
+        }
+
+        else if (umop && !(isLoad && 0x10 == umop))
+        {
+            return false;
+        }
+
+        if (1 == nf)
+        {
+            put(writer, "%se%d%s.v", prefix, eew, umop ? "ff" : "");
+        }
+
+        else
+        {
+            put(writer, "%sseg%de%d%s.v", prefix, nf, eew, umop ? "ff" : "");
+        }
+        put(writer, "\tv%d,(%s)", RD(word), registerNames[RS1(word)]);
+        break;
+
+    case 2:
+        if (1 == nf)
+        {
+            put(writer, "%sse%d.v", prefix, eew);
+        }
+
+        else
+        {
+            put(writer, "%ssseg%de%d.v", prefix, nf, eew);
+        }
+        put(writer, "\tv%d,(%s),%s", RD(word), registerNames[RS1(word)], registerNames[RS2(word)]);
+        break;
+
+    default:
+        if (1 == nf)
+        {
+            put(writer, "%s%sei%d.v", prefix, 1 == mop ? "ux" : "ox", eew);
+        }
+
+        else
+        {
+            put(writer, "%s%sseg%dei%d.v", prefix, 1 == mop ? "ux" : "ox", nf, eew);
+        }
+        put(writer, "\tv%d,(%s),v%d", RD(word), registerNames[RS1(word)], RS2(word));
+        break;
+    }
+
+    if (masked)
+    {
+        put(writer, ",v0.t");
+    }
+    return true;
+}
+
+// HINTs writing x0 have no 32-bit form to print, objdump keeps the c. name
+static bool decodeCompressedHint(uint16_t c, struct writer_t *writer)
+{
+    int32_t imm = signExtend(((c >> 12 & 0x1) << 5) | (c >> 2 & 0x1f), 6);
+    uint32_t rs2 = (c >> 2) & 0x1f;
+
+    if (0x0001 == (c & 0xef83) && 0x0001 != c)
+    {
+        put(writer, "c.nop\t%d", imm);
+    }
+
+    else if (0x4001 == (c & 0xef83))
+    {
+        put(writer, "c.li\tzero,%d", imm);
+    }
+
+    else if (0x6001 == (c & 0xef83) && imm)
+    {
+        put(writer, "c.lui\tzero,0x%x", imm & 0xfffff);
+    }
+
+    else if (0x0002 == (c & 0xef83) && !(c & 0x1000))
+    {
+        put(writer, "c.slli\tzero,0x%x", rs2);
+    }
+
+    else if (0x8002 == (c & 0xef83) && rs2)
+    {
+        put(writer, "%s\tzero,%s", (c & 0x1000) ? "c.add" : "c.mv", registerNames[rs2]);
+    }
+
+    // Shifts by 0 have their own name on RV32
+    else if (0x0002 == (c & 0xf07f))
+    {
+        put(writer, "c.slli64\t%s", registerNames[(c >> 7) & 0x1f]);
+    }
+
+    else if (0x8001 == (c & 0xf87f))
+    {
+        put(writer, "%s\t%s", (c & 0x0400) ? "c.srai64" : "c.srli64", registerNames[8 + ((c >> 7) & 0x7)]);
+    }
+
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Turns a RV32C instruction into the 32-bit one objdump prints it as.
+// Returns 0 for reserved and unsupported encodings
+static uint32_t expandCompressed(uint16_t c)
+{
+    uint32_t rd = (c >> 7) & 0x1f, rs2 = (c >> 2) & 0x1f;
+    uint32_t rdc = ((c >> 2) & 0x7) + 8, rs1c = ((c >> 7) & 0x7) + 8;
+    uint32_t uimm;
+    int32_t imm = signExtend(((c >> 12 & 0x1) << 5) | (c >> 2 & 0x1f), 6);
+
+    switch (((c >> 13) << 2) | (c & 0x3))
+    {
+    // Quadrant 0
+    case 0x00: // c.addi4spn
+        uimm = ((c >> 7 & 0xf) << 6) | ((c >> 11 & 0x3) << 4) | ((c >> 5 & 0x1) << 3) |
+               ((c >> 6 & 0x1) << 2);
+        return uimm ? itype(0x13, 0, rdc, 2, uimm) : 0;
+    case 0x04: // c.fld
+        return itype(0x07, 3, rdc, rs1c, ((c >> 10 & 0x7) << 3) | ((c >> 5 & 0x3) << 6));
+    case 0x08: // c.lw
+        return itype(0x03, 2, rdc, rs1c, ((c >> 10 & 0x7) << 3) | ((c >> 6 & 0x1) << 2) | ((c >> 5 & 0x1) << 6));
+    case 0x0c: // c.flw
+        return itype(0x07, 2, rdc, rs1c, ((c >> 10 & 0x7) << 3) | ((c >> 6 & 0x1) << 2) | ((c >> 5 & 0x1) << 6));
+    case 0x14: // c.fsd
+        return stype(0x27, 3, rs1c, rdc, ((c >> 10 & 0x7) << 3) | ((c >> 5 & 0x3) << 6));
+    case 0x18: // c.sw
+        return stype(0x23, 2, rs1c, rdc, ((c >> 10 & 0x7) << 3) | ((c >> 6 & 0x1) << 2) | ((c >> 5 & 0x1) << 6));
+    case 0x1c: // c.fsw
+        return stype(0x27, 2, rs1c, rdc, ((c >> 10 & 0x7) << 3) | ((c >> 6 & 0x1) << 2) | ((c >> 5 & 0x1) << 6));
+
+    // Quadrant 1
+    case 0x01: // c.addi, c.nop
+        return itype(0x13, 0, rd, rd, imm);
+    case 0x05: // c.jal
+    case 0x15: // c.j
+        imm = signExtend(((c >> 12 & 0x1) << 11) | ((c >> 11 & 0x1) << 4) | ((c >> 9 & 0x3) << 8) |
+                             ((c >> 8 & 0x1) << 10) | ((c >> 7 & 0x1) << 6) | ((c >> 6 & 0x1) << 7) |
+                             ((c >> 3 & 0x7) << 1) | ((c >> 2 & 0x1) << 5),
+                         12);
+        return jtype(0x05 == (((c >> 13) << 2) | (c & 0x3)) ? 1 : 0, imm);
+    case 0x09: // c.li
+        return itype(0x13, 0, rd, 0, imm);
+    case 0x0d: // c.addi16sp, c.lui
+        if (2 == rd)
+        {
+            imm = signExtend(((c >> 12 & 0x1) << 9) | ((c >> 6 & 0x1) << 4) | ((c >> 5 & 0x1) << 6) |
+                                 ((c >> 3 & 0x3) << 7) | ((c >> 2 & 0x1) << 5),
+                             10);
+            return imm ? itype(0x13, 0, 2, 2, imm) : 0;
+        }
+        return imm ? ((imm & 0xfffff) << 12) | (rd << 7) | 0x37 : 0;
+    case 0x11:
+        switch ((c >> 10) & 0x3)
+        {
+        case 0: // c.srli
+            return (c & 0x1000) ? 0 : itype(0x13, 5, rs1c, rs1c, rs2);
+        case 1: // c.srai
+            return (c & 0x1000) ? 0 : itype(0x13, 5, rs1c, rs1c, 0x400 | rs2);
+        case 2: // c.andi
+            return itype(0x13, 7, rs1c, rs1c, imm);
+        default:
+            if (c & 0x1000)
+            {
+                return 0;
+            }
+            switch ((c >> 5) & 0x3)
+            {
+            case 0:
+                return rtype(0x20, 0, rs1c, rs1c, rdc); // c.sub
+            case 1:
+                return rtype(0x00, 4, rs1c, rs1c, rdc); // c.xor
+            case 2:
+                return rtype(0x00, 6, rs1c, rs1c, rdc); // c.or
+            default:
+                return rtype(0x00, 7, rs1c, rs1c, rdc); // c.and
+            }
+        }
+    case 0x19: // c.beqz
+    case 0x1d: // c.bnez
+        imm = signExtend(((c >> 12 & 0x1) << 8) | ((c >> 10 & 0x3) << 3) | ((c >> 5 & 0x3) << 6) |
+                             ((c >> 3 & 0x3) << 1) | ((c >> 2 & 0x1) << 5),
+                         9);
+        return btype(0x19 == (((c >> 13) << 2) | (c & 0x3)) ? 0 : 1, rs1c, 0, imm);
+
+    // Quadrant 2
+    case 0x02: // c.slli
+        return (c & 0x1000) ? 0 : itype(0x13, 1, rd, rd, rs2);
+    case 0x06: // c.fldsp
+        return itype(0x07, 3, rd, 2, ((c >> 12 & 0x1) << 5) | ((c >> 5 & 0x3) << 3) | ((c >> 2 & 0x7) << 6));
+    case 0x0a: // c.lwsp
+        uimm = ((c >> 12 & 0x1) << 5) | ((c >> 4 & 0x7) << 2) | ((c >> 2 & 0x3) << 6);
+        return rd ? itype(0x03, 2, rd, 2, uimm) : 0;
+    case 0x0e: // c.flwsp
+        return itype(0x07, 2, rd, 2, ((c >> 12 & 0x1) << 5) | ((c >> 4 & 0x7) << 2) | ((c >> 2 & 0x3) << 6));
+    case 0x12:
+        if (!(c & 0x1000))
+        {
+            // c.jr, and c.mv printed as mv
+            if (!rs2)
+            {
+                return rd ? itype(0x67, 0, 0, rd, 0) : 0;
+            }
+            return itype(0x13, 0, rd, rs2, 0);
+        }
+
+        if (!rs2)
+        {
+            // c.ebreak, c.jalr
+            return rd ? itype(0x67, 0, 1, rd, 0) : 0x00100073;
+        }
+        return rtype(0x00, 0, rd, rd, rs2); // c.add
+    case 0x16: // c.fsdsp
+        return stype(0x27, 3, 2, rs2, ((c >> 10 & 0x7) << 3) | ((c >> 7 & 0x7) << 6));
+    case 0x1a: // c.swsp
+        return stype(0x23, 2, 2, rs2, ((c >> 9 & 0xf) << 2) | ((c >> 7 & 0x3) << 6));
+    case 0x1e: // c.fswsp
+        return stype(0x27, 2, 2, rs2, ((c >> 9 & 0xf) << 2) | ((c >> 7 & 0x3) << 6));
+
+    default:
+        return 0;
+    }
+}
+
+// Decodes the instruction at code and writes objdump's canonical text for it.
+// Returns its length in bytes, or 0 if it doesn't fit in the available bytes
+// The 32-bit instruction a compressed one is printed as. 0 for the ones
+// printed under a c. name and for reserved encodings
+uint32_t expandInstruction(uint16_t c)
+{
+    char text[MAX_TEXT];
+    struct writer_t writer = {text, 0};
+
+    if (0x6081 == c || 0x6281 == c || decodeCompressedHint(c, &writer))
+    {
+        return 0;
+    }
+    return expandCompressed(c);
+}
+
+uint8_t decodeInstruction(const uint8_t *code, size_t available, addr32_t address, char *text)
+{
+    struct writer_t writer = {text, 0};
+    const opcode_t *op;
+    uint32_t word, aqrl;
+    uint8_t length;
+
+    text[0] = 0x0;
+    if (available < 2)
+    {
+        return 0;
+    }
+    word = code[0] | (code[1] << 8);
+    length = (0x3 == (word & 0x3)) ? 4 : 2;
+
+    if (available < length)
+    {
+        return 0;
+    }
+
+    if (2 == length)
+    {
+        // Zicfiss c.sspush ra / c.sspopchk t0 live in the c.lui hint space
+        if (0x6081 == word || 0x6281 == word)
+        {
+            put(&writer, 0x6081 == word ? "c.sspush\tra" : "c.sspopchk\tt0");
+            return length;
+        }
+
+        if (decodeCompressedHint(word, &writer))
+        {
+            return length;
+        }
+
+        if (!(word = expandCompressed(word)))
+        {
+            put(&writer, ".2byte\t0x%x", code[0] | (code[1] << 8));
+            return length;
+        }
+    }
+
+    else
+    {
+        word |= (code[2] << 16) | ((uint32_t)code[3] << 24);
+
+        if ((0x07 == (word & 0x7f) || 0x27 == (word & 0x7f)) && decodeVectorMemory(word, &writer))
+        {
+            return length;
+        }
+    }
+
+    for (op = opcodes; op->name; op++)
+    {
+        if (((word & op->mask) != op->match) ||
+            ((op->flags & FLAG_SAME_RS) && (RS1(word) != RS2(word))))
+        {
+            continue;
+        }
+        put(&writer, "%s", op->name);
+
+        if (op->flags & FLAG_AQRL)
+        {
+            aqrl = (word >> 25) & 0x3;
+            put(&writer, "%s", 3 == aqrl ? ".aqrl" : (2 == aqrl ? ".aq" : (1 == aqrl ? ".rl" : "")));
+        }
+
+        if (*op->args)
+        {
+            put(&writer, "\t");
+            printArgs(&writer, op->args, word, address);
+        }
+        return length;
+    }
+
+    if (4 == length)
+    {
+        put(&writer, ".4byte\t0x%x", word);
+    }
+
+    else
+    {
+        put(&writer, ".2byte\t0x%x", code[0] | (code[1] << 8));
+    }
+    return length;
+}
@@ -16,6 +16,7 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <ctype.h>
 #include <elf.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -25,35 +26,375 @@
 #include <unistd.h>
 
 #include "datatypes.h"
+#include "decoder.h"
 #include "disas.h"
 #include "errors.h"
+#include "fields.h"
 #include "gadget.h"
+#include "scan.h"
 
 #define DEFAULT_PERM 0644
 #define DUMMY_FILE "/tmp/disas.s"
+#define INSTRUCTION_BLOCK 4096
+#define TEXT_BLOCK 65536
+#define UNIMP 0xc0001073
+#define DISTANCE_UNKNOWN 0xffff
+#define DISTANCE_FAR 0x8000
+#define DECODE_CACHE_BITS 12
+
+typedef struct mnemonic_class_t
+{
+    const char *prefix;
+    op_t operation;
+    bool useImmediate;
+} mnemonic_class_t;
+
+typedef enum symbol_kind_t
+{
+    SYM_LABEL,
+    SYM_CODE,
+    SYM_DATA
+} symbol_kind_t;
+
+typedef struct symbol_t
+{
+    Elf32_Addr address;
+    symbol_kind_t kind;
+} symbol_t;
+
+typedef struct cached_t
+{
+    uint32_t encoding;
+    ins32_t *record;
+} cached_t;
+
+// State shared by the backward walks of one section
+typedef struct backward_t
+{
+    const uint8_t *code;
+    Elf32_Addr base;
+    Elf32_Addr end;
+    ins32_t **decoded;
+    uint16_t *distance;
+    ins32_t **path;
+    struct branch_t *tests;
+    op_t terminator;
+    uint16_t length;
+    bool toStart;
+    struct branch_t *branches;
+    size_t nBranches;
+    ins32_t **edges;
+} backward_t;
+
+// F/D extension mnemonics. Order matters: the first matching prefix wins
+static const mnemonic_class_t floatClasses[] = {
+    {"fence", NOP},
+    {"flw", LOAD},
+    {"fld", LOAD},
+    {"flh", LOAD},
+    {"flq", LOAD},
+    {"fsqrt", DIV},
+    {"fsw", STORE},
+    {"fsd", STORE},
+    {"fsh", STORE},
+    {"fsq", STORE},
+    {"fmv", MOV},
+    {"fsgnj", MOV},
+    {"fcvt", MOV},
+    {"fabs", MOV},
+    {"fneg", NEG},
+    {"fadd", ADD},
+    {"fsub", SUB},
+    {"fmul", MUL},
+    {"fmadd", MUL},
+    {"fmsub", MUL},
+    {"fnm", MUL},
+    {"fdiv", DIV},
+    {"feq", SET},
+    {"flt", SET},
+    {"fle", SET},
+    {"fmin", SET},
+    {"fmax", SET},
+    {"fclass", SET},
+    {"frcsr", CSR},
+    {"fscsr", CSR},
+    {"frrm", CSR},
+    {"fsrm", CSR},
+    {"frflags", CSR},
+    {"fsflags", CSR},
+    {NULL, IO}};
+
+// Zba, Zbb, Zbs, Zbc and Zicond. Matched against the whole mnemonic
+static const mnemonic_class_t bitmanipClasses[] = {
+    {"sh1add", ADD},
+    {"sh2add", ADD},
+    {"sh3add", ADD},
+    {"sh1add.uw", ADD},
+    {"sh2add.uw", ADD},
+    {"sh3add.uw", ADD},
+    {"add.uw", ADD},
+    {"slli.uw", SHIFT, true},
+    {"andn", AND},
+    {"orn", OR},
+    {"xnor", OR},
+    {"rol", SHIFT},
+    {"ror", SHIFT},
+    {"rori", SHIFT, true},
+    {"sext.b", BITMANIP},
+    {"sext.h", BITMANIP},
+    {"sext.w", BITMANIP},
+    {"zext.b", BITMANIP},
+    {"zext.h", BITMANIP},
+    {"min", MINMAX},
+    {"minu", MINMAX},
+    {"max", MINMAX},
+    {"maxu", MINMAX},
+    {"clz", BITMANIP},
+    {"ctz", BITMANIP},
+    {"cpop", BITMANIP},
+    {"orc.b", BITMANIP},
+    {"rev8", BITMANIP},
+    {"bclr", BITMANIP},
+    {"bclri", BITMANIP, true},
+    {"bext", BITMANIP},
+    {"bexti", BITMANIP, true},
+    {"binv", BITMANIP},
+    {"binvi", BITMANIP, true},
+    {"bset", BITMANIP},
+    {"bseti", BITMANIP, true},
+    {"clmul", MUL},
+    {"clmulh", MUL},
+    {"clmulr", MUL},
+    {"czero.eqz", CMOV},
+    {"czero.nez", CMOV},
+    {NULL, UNSUPORTED}};
+
+struct region_t region;
+
+struct labels_t labels;
+
+struct trie_t *trie;
+
+// Decoded and classified records by encoding (direct-mapped)
+static cached_t decodeCache[1 << DECODE_CACHE_BITS];
+
+// CSRs reachable from U-mode. Any other one needs kernel mode
+static const char *userCsrNames[] = {
+    "fflags", "frm", "fcsr", "cycle", "time", "instret", "cycleh", "timeh",
+    "instreth", "hpmcounter", "vstart", "vxsat", "vxrm", "vcsr", "vl", "vtype",
+    "vlenb", "ssp", "seed", "jvt", NULL};
+
+static void classifyInstruction(struct ins32_t *instruction);
 
 static void setInmediate(struct ins32_t *instruction);
 
+static void setFloatData(struct ins32_t *instruction);
+
+static void setShadowStackData(struct ins32_t *instruction);
+
+static bool setBitmanipData(struct ins32_t *instruction);
+
+static void setVectorData(struct ins32_t *instruction);
+
+static void setCsrData(struct ins32_t *instruction);
+
+static uint8_t parseRegister(const char *name, size_t length);
+
+static void setRegisters(struct ins32_t *instruction);
+
 static uint8_t process_elf(char *elfFile);
 
 static uint8_t parseContent(char *assemblyFile);
 
+static uint8_t parseElf(char *elfFile);
+
+static bool processInstruction(struct ins32_t *instruction);
+
+static bool pushInstruction(struct ins32_t *instruction);
+
+static bool endsGadget(struct ins32_t *instruction);
+
+static ins32_t *decodeClassified(const uint8_t *code, Elf32_Addr base, Elf32_Addr end, Elf32_Addr address,
+                                 const struct fields_t *fields, size_t index);
+
+static __attribute__((always_inline)) inline bool isPcRelative(uint32_t encoding);
+
+static void scanLinear(const uint8_t *code, Elf32_Addr base, size_t size, symbol_t *symbols, size_t nSymbols);
+
+static void scanBackward(const uint8_t *code, Elf32_Addr base, size_t size);
+
+static ins32_t *lookupInstruction(struct backward_t *walk, Elf32_Addr address);
+
+static uint16_t startDistance(struct backward_t *walk, Elf32_Addr address, uint16_t budget);
+
+static bool hasPredecessor(struct backward_t *walk, Elf32_Addr address, uint8_t length);
+
+static bool nextEdge(struct backward_t *walk, Elf32_Addr address, size_t *edge, Elf32_Addr *from, bool *taken);
+
+static ins32_t *edgeInstruction(struct backward_t *walk, Elf32_Addr from, bool taken, struct branch_t *branch);
+
+static bool contradicts(struct backward_t *walk, uint16_t depth);
+
+static __attribute__((always_inline)) inline bool excludes(uint8_t first, uint8_t second);
+
+static void walkBack(struct backward_t *walk, Elf32_Addr address, uint16_t depth);
+
+static void emitPath(struct backward_t *walk, uint16_t length);
+
+static size_t collectSymbols(char *content, size_t size, Elf32_Shdr *sections, Elf32_Half nSections, symbol_t **symbols);
+
+static int compareSymbols(const void *a, const void *b);
+
+static void pushLabel(addr32_t address);
+
+static void addLabels(Elf32_Addr base, Elf32_Addr end, symbol_t *symbols, size_t nSymbols);
+
+static int compareLabels(const void *a, const void *b);
+
+static char *newText(const char *text);
+
 static __attribute__((always_inline)) inline void removeExtraInfo(struct ins32_t *instruction);
 
-static inline void setRegDest(struct ins32_t *instruction);
+static struct ins32_t *newInstruction(void);
+
+static char *readContent(FILE *file, size_t *size);
 
 static __attribute__((always_inline)) inline bool checkArch(Elf32_Half arch);
 
 static __attribute__((always_inline)) inline bool getBits(Elf32_Ehdr *header);
 
-static __attribute__((always_inline)) inline uint16_t pushToPGL(struct ins32_t *instruction);
+static __attribute__((always_inline)) inline bool inFile(size_t size, size_t offset, size_t length);
+
+static __attribute__((always_inline)) inline size_t pushToRegion(struct ins32_t *instruction);
+
+static __attribute__((always_inline)) inline void newRegion(void);
+
+static __attribute__((always_inline)) inline uint32_t fetchWord(const uint8_t *code, Elf32_Addr base, Elf32_Addr end, Elf32_Addr address);
+
+static __attribute__((always_inline)) inline uint32_t tableWord(uint32_t word);
+
+static inline size_t pushToRegion(struct ins32_t *instruction)
+{
+    // Appends the record to the current region and returns its index
+    ins32_t **tmp;
+
+    if (region.count == region.capacity)
+    {
+        region.capacity = region.capacity ? 2 * region.capacity : INSTRUCTION_BLOCK;
+        tmp = (ins32_t **)realloc(region.instructions, region.capacity * sizeof(ins32_t *));
+        if (!tmp)
+        {
+            fprintf(stderr, "[-] Not enough memory for the instruction list\n");
+            exit(EXIT_FAILURE);
+        }
+        region.instructions = tmp;
+    }
+    region.instructions[region.count] = instruction;
+    return region.count++;
+}
+
+// What comes next doesn't follow what is already there, walks must stop
+static inline void newRegion(void)
+{
+    region.count = 0;
+}
+
+// Up to 4 bytes at address, missing ones past the end read as 0
+static inline uint32_t fetchWord(const uint8_t *code, Elf32_Addr base, Elf32_Addr end, Elf32_Addr address)
+{
+    uint32_t word = 0;
+    uint8_t i;
+
+    for (i = 0; i < 4 && address + i < end; i++)
+    {
+        word |= (uint32_t)code[address - base + i] << (8 * i);
+    }
+    return word;
+}
+
+// What the tables see for the word at an instruction: the instruction
+// itself, or the 32-bit one a compressed instruction is printed as
+static inline uint32_t tableWord(uint32_t word)
+{
+    return 0x3 == (word & 0x3) ? word : expandInstruction(word & 0xffff);
+}
+
+// Instructions are handed out from big blocks instead of one calloc each
+static struct ins32_t *newInstruction(void)
+{
+    static struct ins32_t *block = NULL;
+    static size_t used = INSTRUCTION_BLOCK;
+
+    if (INSTRUCTION_BLOCK == used)
+    {
+        block = (ins32_t *)calloc(INSTRUCTION_BLOCK, sizeof(ins32_t));
+        if (!block)
+        {
+            fprintf(stderr, "[-] Not enough memory for the instructions\n");
+            exit(EXIT_FAILURE);
+        }
+        used = 0;
+    }
+    return &block[used++];
+}
+
+// Same idea for the text of natively decoded instructions
+static char *newText(const char *text)
+{
+    static char *block = NULL;
+    static size_t used = TEXT_BLOCK;
+    size_t length = strlen(text) + 1;
+    char *res;
+
+    if (TEXT_BLOCK - used < length)
+    {
+        block = (char *)malloc(TEXT_BLOCK);
+        if (!block)
+        {
+            fprintf(stderr, "[-] Not enough memory for the instruction text\n");
+            exit(EXIT_FAILURE);
+        }
+        used = 0;
+    }
+    res = &block[used];
+    memcpy(res, text, length);
+    used += length;
+    return res;
+}
+
+// Loads a whole file (objdump output or the ELF itself) into memory
+static char *readContent(FILE *file, size_t *size)
+{
+    char *buf;
+    long length;
+
+    if (fseek(file, 0, SEEK_END) || (length = ftell(file)) < 0 ||
+        fseek(file, 0, SEEK_SET))
+    {
+        return NULL;
+    }
+
+    buf = (char *)malloc(length + 1);
+    if (!buf)
+    {
+        return NULL;
+    }
+
+    if (length && !fread(buf, length, 1, file))
+    {
+        free(buf);
+        return NULL;
+    }
+    buf[length] = 0x0;
+    *size = length;
+    return buf;
+}
 
-static inline uint16_t pushToPGL(struct ins32_t *instruction)
+// Whether length bytes at offset are all in a file of size bytes. Written
+// so that nothing can wrap around
+static inline bool inFile(size_t size, size_t offset, size_t length)
 {
-    // Inserts new record in the list and return it's index
-    static uint8_t pos = 0;
-    preliminary_gadget_list[pos % 100] = instruction;
-    return pos++ % 100;
+    return offset <= size && length <= size - offset;
 }
 
 static inline bool checkArch(Elf32_Half arch)
@@ -134,7 +475,14 @@ uint8_t disassemble(char *elfFile)
     int returnStatus, fd, tempfd;
     uint8_t res;
 
-    char *args[] = {"/opt/rv32/bin/riscv32-unknown-linux-gnu-objdump", "-d", elfFile, NULL};
+    char *objdumpArgs[] = {"/opt/rv32/bin/riscv32-unknown-linux-gnu-objdump", "-d", elfFile, NULL};
+
+    // Decode natively unless the external objdump was asked for
+    if (!(args.options & OPT_OBJDUMP))
+    {
+        res = process_elf(elfFile);
+        return res ? res : parseElf(elfFile);
+    }
 
     fd = open(DUMMY_FILE, O_WRONLY | O_CREAT, DEFAULT_PERM);
     if (!fd)
@@ -164,7 +512,7 @@ uint8_t disassemble(char *elfFile)
         dup2(tempfd, STDERR_FILENO);
         close(fd);
         close(tempfd);
-        execve(args[0], args, NULL);
+        execve(objdumpArgs[0], objdumpArgs, NULL);
     }
 
     close(fd);
@@ -197,16 +545,14 @@ fail:
 static uint8_t parseContent(char *assemblyFile)
 {
     FILE *file;
-    char *line, *address, *pos, *opcode;
-    uint8_t nTabs, bytes, last;
-    uint16_t offset;
-    int32_t baseAddress, endPos;
+    char *content, *line, *next, *pos, *opcode;
+    uint8_t nTabs, bytes;
+    uint16_t offset = 0;
+    int32_t baseAddress = 0, endPos;
     ins32_t *current;
-    size_t startPos;
-    bool start = false, isEnd = false;
+    size_t startPos, size, length;
+    bool start = false;
     uint8_t startProcessing = 0;
-    size_t len = 0;
-    ssize_t read = -1;
 
     file = fopen(assemblyFile, "r");
 
@@ -216,52 +562,63 @@ static uint8_t parseContent(char *assemblyFile)
         return EOPEN;
     }
     unlink(assemblyFile);
-    list = create();
-    spDuplicated = create();
+    content = readContent(file, &size);
+    fclose(file);
+
+    if (!content)
+    {
+        fprintf(stderr, "[-] Unable to read the dummy file\n");
+        return EIO;
+    }
+    trie = createTrie();
 
-    do
+    // Lines are split in place: the instructions keep pointing into content
+    for (line = content; line < content + size; line = next + 1)
     {
-        read = getline(&line, &len, file) != -1;
-        if (!read)
+        next = strchr(line, '\n');
+        if (!next)
         {
-            break;
+            next = content + size;
         }
+        *next = 0x0;
+        length = next - line;
 
         // Start processing from .text section
-        if (!strstr(line, ".text:") && !startProcessing)
+        if (!startProcessing && !strstr(line, ".text:"))
         {
             continue;
         }
         startProcessing = 1;
 
-        // Ensures ret is not the last instruction
-        if (isEnd && !strstr(line, "\n"))
-        {
-            start = true;
-            isEnd = false;
-        }
-
         // Check if has reached the end of a function
-        if ((0 == strcmp(line, "\n")) || strstr(line, "...") ||
-            strstr(line, "unimp"))
+        if ((0 == length) || strstr(line, "...") || strstr(line, "unimp"))
         {
-            isEnd = false;
-            start = false;
+            // Padding only breaks the chain when following fall-through
+            if ((args.options & OPT_CROSS) && length)
+            {
+                newRegion();
+            }
+
+            else
+            {
+                start = false;
+            }
             continue;
         }
 
         // Check if the line is the start of a function
-        if (!start && (':' == line[strlen(line) - 2]) &&
+        if (!start && (':' == line[length - 1]) &&
             ((line[0] - '0' >= 0) && (line[0] - '0' <= 9)))
         {
             start = true;
-            address = calloc(9, sizeof(char));
-            address = strncpy(address, line, 8);
             // Stores the base address of the function
-            baseAddress = strtol(address, NULL, 0x10);
-            free(address);
-            address = NULL;
+            baseAddress = strtol(line, NULL, 0x10);
             offset = 0;
+
+            if (args.options & OPT_CROSS)
+            {
+                pushLabel(baseAddress);
+            }
             continue;
         }
 
@@ -273,17 +630,7 @@ static uint8_t parseContent(char *assemblyFile)
 
             // Check if the current line has comments.
             pos = strstr(line, "#");
-
-            if (!pos)
-            {
-                pos = strstr(line, "\n");
-                endPos = pos - line;
-            }
-
-            else
-            {
-                endPos = pos - line - 1;
-            }
+            endPos = pos ? pos - line - 1 : (int32_t)length;
 
             // Advances the start pointer. At the end line[startpos] till line[endPos]
             // will have our instruction disassembled
@@ -297,168 +644,995 @@ static uint8_t parseContent(char *assemblyFile)
             }
 
             bytes = 0;
-            startPos += 1;
-            current = (ins32_t *)calloc(1, sizeof(ins32_t));
-            current->address = baseAddress + offset;
-            current->disassembled = (char *)calloc((endPos - startPos) + 1, sizeof(char));
-            strncpy(current->disassembled, &line[startPos], endPos - startPos);
-            last = fillData(current);
-
-            if (JMP == current->operation)
-            {
-                removeExtraInfo(current);
-            }
-
             opcode = strstr(line, "\t") + 1;
             while (0x20 != *opcode++)
             {
                 bytes++;
             }
 
+            startPos += 1;
+            line[endPos] = 0x0;
+            current = newInstruction();
+            // Past padding the offset no longer matches, the line has the address
+            current->address = (args.options & OPT_CROSS) ? strtol(line, NULL, 0x10) : baseAddress + offset;
+            current->disassembled = &line[startPos];
             current->isCompressed = (4 == bytes) ? true : false;
 
-            switch (args.mode)
+            if (processInstruction(current) && !(args.options & OPT_CROSS))
             {
-            case JOP_MODE:
-                if ((JMP == current->operation) &&
-                    strstr(current->disassembled, "jr"))
-                {
-                    processGadgets(last, current->operation);
-                    start = false;
-                    isEnd = true;
-                }
-                break;
+                start = false;
+            }
 
-            case SYSCALL_MODE:
-                if (SYSCALL == current->operation)
-                {
-                    processGadgets(last, current->operation);
-                    start = false;
-                    isEnd = true;
-                }
-                break;
+            offset += bytes / 2;
+        }
+    }
 
-            case RET_MODE:
-                if (RET == current->operation)
-                {
-                    processGadgets(last, current->operation);
-                    start = false;
-                    isEnd = true;
-                }
-                break;
+    qsort(labels.addresses, labels.count, sizeof(addr32_t), compareLabels);
+    printContent(trie, DISPATCHER_MODE == args.mode ? rankDispatchers : NULL);
+    return 0;
+}
 
-            case GENERIC_MODE:
-                if ((RET == current->operation) ||
-                    (SYSCALL == current->operation) ||
-                    ((JMP == current->operation) &&
-                     strstr(current->disassembled, "jr")))
-                {
-                    processGadgets(last, current->operation);
-                    start = false;
-                    isEnd = true;
-                }
-                break;
+// Classifies the instruction and looks for a gadget ending on it.
+// Returns true if the current function must not be processed any further
+static bool processInstruction(struct ins32_t *instruction)
+{
+    classifyInstruction(instruction);
 
-            default:
-                break;
-            }
+    if (JMP == instruction->operation)
+    {
+        removeExtraInfo(instruction);
+    }
+    return pushInstruction(instruction);
+}
 
-            offset += bytes / 2;
-        }
+// Same as processInstruction() for an instruction that is already classified
+static bool pushInstruction(struct ins32_t *instruction)
+{
+    size_t last = pushToRegion(instruction);
 
-    } while (read);
+    if (endsGadget(instruction))
+    {
+        processGadgets(last, instruction->operation);
+        return true;
+    }
+    return false;
+}
 
-    printContent(list);
-    return 0;
+// Whether the selected mode looks for gadgets ending on this instruction
+static bool endsGadget(struct ins32_t *instruction)
+{
+    switch (args.mode)
+    {
+    case JOP_MODE:
+        return (JMP == instruction->operation) && (REG_NONE != instruction->rs[0]);
+
+    case DISPATCHER_MODE:
+        return ((JMP == instruction->operation) || (CALL == instruction->operation)) &&
+               (REG_NONE != instruction->rs[0]);
+
+    // Calls through a register, they return to whatever they left in the link register
+    case COP_MODE:
+        return (CALL == instruction->operation) && (REG_NONE != instruction->rs[0]);
+
+    // A pivot can be followed by any way out
+    case PIVOT_MODE:
+        return (RET == instruction->operation) ||
+               (SYSCALL == instruction->operation) ||
+               ((ERET == instruction->operation) && (args.options & OPT_KERNEL)) ||
+               (((JMP == instruction->operation) || (CALL == instruction->operation)) &&
+                (REG_NONE != instruction->rs[0]));
+
+    case SYSCALL_MODE:
+        return SYSCALL == instruction->operation;
+
+    case RET_MODE:
+        return (RET == instruction->operation) ||
+               ((ERET == instruction->operation) && (args.options & OPT_KERNEL));
+
+    case GENERIC_MODE:
+        return (RET == instruction->operation) ||
+               (SYSCALL == instruction->operation) ||
+               ((ERET == instruction->operation) && (args.options & OPT_KERNEL)) ||
+               ((JMP == instruction->operation) && (REG_NONE != instruction->rs[0]));
+
+    default:
+        return false;
+    }
 }
 
-uint8_t fillData(struct ins32_t *instruction)
+// Branches and jal print their target, so their text depends on the address
+static inline bool isPcRelative(uint32_t encoding)
 {
-    char start = instruction->disassembled[0];
+    uint8_t funct3 = (encoding >> 13) & 0x7;
 
-    switch (start)
+    if (0x3 == (encoding & 0x3))
     {
-    case 'l':
-        if (!strstr(instruction->disassembled, ".w"))
-        {
-            instruction->operation = LOAD;
-        }
+        return (0x63 == (encoding & 0x7f)) || (0x6f == (encoding & 0x7f));
+    }
+    return (0x1 == (encoding & 0x3)) && (1 == funct3 || funct3 >= 5);
+}
 
-        else
-        {
-            instruction->operation = ATOMIC;
-        }
-        instruction->useImmediate = false;
-        break;
+// Decoded and classified record for the instruction at address, word index
+// of fields. Most encodings repeat a lot, so they are only classified the
+// first time and later copies just get their own address. The table
+// classification is used when it covers the word, the text one otherwise
+static ins32_t *decodeClassified(const uint8_t *code, Elf32_Addr base, Elf32_Addr end, Elf32_Addr address,
+                                 const struct fields_t *fields, size_t index)
+{
+    uint32_t encoding = fetchWord(code, base, end, address);
+    ins32_t *current;
+    cached_t *slot;
+    bool cacheable;
 
-    case 'b':
-        instruction->operation = CMP;
-        instruction->useImmediate = false;
-        break;
+    if (0x3 != (encoding & 0x3))
+    {
+        encoding &= 0xffff;
+    }
+    cacheable = (address + (0x3 == (encoding & 0x3) ? 4 : 2) <= end) && !isPcRelative(encoding);
+    slot = &decodeCache[(encoding * 0x9e3779b1u) >> (32 - DECODE_CACHE_BITS)];
+    current = newInstruction();
 
-    case 'j':
-    case 't':
-        if (strstr(instruction->disassembled, "jal"))
-        {
-            instruction->operation = CALL;
-        }
+    if (cacheable && slot->record && slot->encoding == encoding)
+    {
+        *current = *slot->record;
+        current->address = address;
+        return current;
+    }
+    current->address = address;
+    current->isCompressed = 0x3 != (encoding & 0x3);
+    current->encoding = encoding;
 
-        else
+    if (!classifyFields(fields, index, current))
+    {
+        getDisassembled(current);
+        classifyInstruction(current);
+    }
+
+    if (cacheable)
+    {
+        slot->encoding = encoding;
+        slot->record = current;
+    }
+    return current;
+}
+
+// Text of the instruction, natively decoded ones are rendered the first
+// time it is needed
+const char *getDisassembled(struct ins32_t *instruction)
+{
+    char text[MAX_TEXT];
+    uint8_t code[4], i;
+
+    if (!instruction->disassembled)
+    {
+        for (i = 0; i < 4; i++)
         {
-            instruction->operation = JMP;
+            code[i] = instruction->encoding >> (8 * i);
         }
+        decodeInstruction(code, instruction->isCompressed ? 2 : 4, instruction->address, text);
+        instruction->disassembled = newText(text);
+    }
+    return instruction->disassembled;
+}
 
-        instruction->useImmediate = false;
-        break;
+static int compareSymbols(const void *a, const void *b)
+{
+    const symbol_t *first = (const symbol_t *)a, *second = (const symbol_t *)b;
 
-    case 'o':
-    case 'x':
-        instruction->operation = OR;
-        if (strstr(instruction->disassembled, "i"))
+    if (first->address != second->address)
+    {
+        return first->address < second->address ? -1 : 1;
+    }
+    return (int)first->kind - (int)second->kind;
+}
+
+// Gathers the addresses where objdump would print a label, plus the $x/$d
+// mapping symbols. The result is sorted by address
+static size_t collectSymbols(char *content, size_t size, Elf32_Shdr *sections, Elf32_Half nSections, symbol_t **symbols)
+{
+    Elf32_Shdr *table = NULL, *strings;
+    Elf32_Sym *symbol;
+    size_t count = 0, nSymbols, i;
+    const char *name;
+    Elf32_Half j;
+
+    // objdump falls back to the dynamic symbols of stripped binaries
+    for (j = 0; j < nSections; j++)
+    {
+        if (SHT_SYMTAB == sections[j].sh_type || (!table && SHT_DYNSYM == sections[j].sh_type))
         {
-            instruction->useImmediate = true;
-            setInmediate(instruction);
+            table = &sections[j];
         }
+    }
+    *symbols = NULL;
 
-        else
+    if (!table || table->sh_link >= nSections || !inFile(size, table->sh_offset, table->sh_size))
+    {
+        return 0;
+    }
+    strings = &sections[table->sh_link];
+    if (!inFile(size, strings->sh_offset, strings->sh_size))
+    {
+        return 0;
+    }
+    nSymbols = table->sh_size / sizeof(Elf32_Sym);
+    *symbols = (symbol_t *)malloc(nSymbols * sizeof(symbol_t) + 1);
+
+    if (!*symbols)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < nSymbols; i++)
+    {
+        symbol = &((Elf32_Sym *)(content + table->sh_offset))[i];
+        if (STT_SECTION == ELF32_ST_TYPE(symbol->st_info) || STT_FILE == ELF32_ST_TYPE(symbol->st_info) ||
+            SHN_UNDEF == symbol->st_shndx || symbol->st_shndx >= nSections ||
+            !(sections[symbol->st_shndx].sh_flags & SHF_EXECINSTR) ||
+            symbol->st_name >= strings->sh_size)
         {
-            instruction->useImmediate = false;
+            continue;
         }
-        break;
+        name = content + strings->sh_offset + symbol->st_name;
 
-    case 'e':
-        if (strstr(instruction->disassembled, "ecall"))
+        if (!name[0])
         {
-            instruction->operation = SYSCALL;
+            continue;
         }
+        (*symbols)[count].address = symbol->st_value;
 
-        else
+        if (0 == strncmp(name, "$x", 2))
         {
-            instruction->operation = BRK;
+            (*symbols)[count].kind = SYM_CODE;
         }
-        instruction->useImmediate = false;
-        break;
 
-    case 'r':
-        if (!strstr(instruction->disassembled, "remu"))
+        else if (0 == strncmp(name, "$d", 2))
         {
-            instruction->operation = RET;
+            (*symbols)[count].kind = SYM_DATA;
         }
 
         else
         {
-            instruction->operation = MUL;
+            (*symbols)[count].kind = SYM_LABEL;
         }
-        instruction->useImmediate = false;
-        break;
+        count++;
+    }
+    qsort(*symbols, count, sizeof(symbol_t), compareSymbols);
+    return count;
+}
 
-    case 'n':
-        if (strstr(instruction->disassembled, "t"))
+static void pushLabel(addr32_t address)
+{
+    addr32_t *tmp;
+
+    if (labels.count == labels.capacity)
+    {
+        labels.capacity = labels.capacity ? 2 * labels.capacity : INSTRUCTION_BLOCK;
+        tmp = (addr32_t *)realloc(labels.addresses, labels.capacity * sizeof(addr32_t));
+        if (!tmp)
         {
-            instruction->operation = NOT;
+            fprintf(stderr, "[-] Not enough memory for the function labels\n");
+            exit(EXIT_FAILURE);
+        }
+        labels.addresses = tmp;
+    }
+    labels.addresses[labels.count++] = address;
+}
+
+// The labels objdump prints for the section: its start and every function
+static void addLabels(Elf32_Addr base, Elf32_Addr end, symbol_t *symbols, size_t nSymbols)
+{
+    size_t i;
+
+    pushLabel(base);
+
+    for (i = 0; i < nSymbols; i++)
+    {
+        if (SYM_LABEL == symbols[i].kind && symbols[i].address > base && symbols[i].address < end)
+        {
+            pushLabel(symbols[i].address);
+        }
+    }
+}
+
+static int compareLabels(const void *a, const void *b)
+{
+    addr32_t first = *(const addr32_t *)a, second = *(const addr32_t *)b;
+
+    if (first != second)
+    {
+        return first < second ? -1 : 1;
+    }
+    return 0;
+}
+
+// Decodes the executable sections straight from the ELF file
+static uint8_t parseElf(char *elfFile)
+{
+    FILE *file;
+    char *content, *name;
+    size_t size, nSymbols;
+    Elf32_Ehdr *header;
+    Elf32_Shdr *sections;
+    symbol_t *symbols;
+    Elf32_Half i;
+    bool startProcessing = false;
+
+    file = fopen(elfFile, "rb");
+
+    if (!file)
+    {
+        fprintf(stderr, "[-] Error while opening the file\n");
+        return EOPEN;
+    }
+    content = readContent(file, &size);
+    fclose(file);
+
+    if (!content)
+    {
+        fprintf(stderr, "[-] Error while reading the ELF file\n");
+        return EIO;
+    }
+    header = (Elf32_Ehdr *)content;
+
+    if (!header->e_shnum || !inFile(size, header->e_shoff, header->e_shnum * sizeof(Elf32_Shdr)) ||
+        header->e_shstrndx >= header->e_shnum)
+    {
+        fprintf(stderr, "[-] Invalid ELF file\n");
+        free(content);
+        return EIFILE;
+    }
+    sections = (Elf32_Shdr *)(content + header->e_shoff);
+    nSymbols = collectSymbols(content, size, sections, header->e_shnum, &symbols);
+    trie = createTrie();
+
+    for (i = 0; i < header->e_shnum; i++)
+    {
+        if (!(sections[i].sh_flags & SHF_EXECINSTR) || SHT_NOBITS == sections[i].sh_type ||
+            !inFile(size, sections[i].sh_offset, sections[i].sh_size))
+        {
+            continue;
+        }
+
+        // Start processing from .text section
+        if (!startProcessing)
+        {
+            if (!inFile(size, sections[header->e_shstrndx].sh_offset, (size_t)sections[i].sh_name + 1))
+            {
+                continue;
+            }
+            name = content + sections[header->e_shstrndx].sh_offset + sections[i].sh_name;
+
+            if (strlen(name) < 5 || strcmp(&name[strlen(name) - 5], ".text"))
+            {
+                continue;
+            }
+            startProcessing = true;
+        }
+
+        if (args.options & OPT_CROSS)
+        {
+            addLabels(sections[i].sh_addr, sections[i].sh_addr + sections[i].sh_size, symbols, nSymbols);
+        }
+
+        if (BACKWARD_SCAN == args.scan)
+        {
+            scanBackward((const uint8_t *)content + sections[i].sh_offset, sections[i].sh_addr,
+                         sections[i].sh_size);
+        }
+
+        else
+        {
+            scanLinear((const uint8_t *)content + sections[i].sh_offset, sections[i].sh_addr,
+                       sections[i].sh_size, symbols, nSymbols);
+        }
+    }
+
+    qsort(labels.addresses, labels.count, sizeof(addr32_t), compareLabels);
+    printContent(trie, DISPATCHER_MODE == args.mode ? rankDispatchers : NULL);
+    free(symbols);
+    free(content);
+    return 0;
+}
+
+// Walks the section in order and splits it into functions the same way
+// parseContent() splits objdump's output
+static void scanLinear(const uint8_t *code, Elf32_Addr base, size_t size, symbol_t *symbols, size_t nSymbols)
+{
+    // The window outlives the section, as the region does. It keeps the
+    // instructions the longest gadget can look at, terminator included
+    static Elf32_Addr window[MAX_DEPTH + 1];
+    static size_t seen = 0, decoded = 0;
+    size_t nCandidates, sym = 0, cand = 0, first, from, k, chunk;
+    size_t windowSize = maxGadgetLength(RET) > maxGadgetLength(JMP) ? maxGadgetLength(RET) : maxGadgetLength(JMP);
+    Elf32_Addr address = base, end = base + size, next, offset;
+    struct fields_t batch;
+    uint32_t *candidates;
+    ins32_t *current;
+    uint16_t half;
+    uint8_t length;
+    bool start, isData = false, stop = false;
+
+    nCandidates = findTerminators(code, size, &candidates);
+
+    // objdump labels the section start even when there is no symbol
+    start = true;
+
+    while (sym < nSymbols && symbols[sym].address < address)
+    {
+        sym++;
+    }
+
+    while (address < end)
+    {
+        while (sym < nSymbols && symbols[sym].address <= address)
+        {
+            if (SYM_LABEL == symbols[sym].kind)
+            {
+                start = true;
+            }
+
+            else
+            {
+                isData = SYM_DATA == symbols[sym].kind;
+            }
+            sym++;
+        }
+        next = (sym < nSymbols && symbols[sym].address < end) ? symbols[sym].address : end;
+
+        // Nothing else to look at until the next function
+        if (!start)
+        {
+            address = next;
+            continue;
+        }
+
+        // Data in the middle of code. It just breaks the gadget chain
+        if (isData)
+        {
+            current = newInstruction();
+            current->address = address;
+            current->disassembled = newText(".word");
+            processInstruction(current);
+            decoded = ++seen;
+            address = next;
+            continue;
+        }
+        offset = address - base;
+        half = code[offset] | (code[offset + 1] << 8);
+        length = (0x3 == (half & 0x3)) ? 4 : 2;
+
+        if (length > end - address)
+        {
+            break;
+        }
+
+        while (cand < nCandidates && base + candidates[cand] < address)
+        {
+            cand++;
+        }
+
+        // Until a candidate only the instruction boundaries are needed. The
+        // window keeps the last ones, in the order objdump would list them
+        if (cand == nCandidates || base + candidates[cand] != address)
+        {
+            // Padding and unimp end the function, as "..." and unimp do in objdump's output
+            if (!half || (4 == length && UNIMP == (half | (code[offset + 2] << 16) |
+                                                  ((uint32_t)code[offset + 3] << 24))))
+            {
+                // Following fall-through it only breaks the chain
+                if (args.options & OPT_CROSS)
+                {
+                    newRegion();
+                    decoded = seen;
+                }
+
+                else
+                {
+                    start = false;
+                }
+            }
+
+            else
+            {
+                window[seen++ % windowSize] = address;
+            }
+            // Like objdump, an instruction running into a symbol does not
+            // move the symbol
+            address = address + length > next ? next : address + length;
+            continue;
+        }
+
+        // The candidate starts an instruction: decode the longest gadget
+        // that could end on it, skipping what is already decoded
+        window[seen++ % windowSize] = address;
+        first = seen > windowSize ? seen - windowSize : 0;
+
+        from = decoded > first ? decoded : first;
+
+        // Deep gadgets can need more words than a single batch holds
+        for (chunk = from; chunk < seen; chunk += FIELD_BATCH)
+        {
+            for (batch.count = 0, k = chunk; k < seen && batch.count < FIELD_BATCH; k++)
+            {
+                batch.word[batch.count++] = tableWord(fetchWord(code, base, end, window[k % windowSize]));
+            }
+            extractFields(&batch);
+
+            for (k = chunk; k < chunk + batch.count; k++)
+            {
+                // Keep the backward walks from joining two unrelated windows
+                if (k != decoded)
+                {
+                    newRegion();
+                }
+                current = decodeClassified(code, base, end, window[k % windowSize], &batch, k - chunk);
+                stop = pushInstruction(current);
+                decoded = k + 1;
+            }
+        }
+
+        if (stop && !(args.options & OPT_CROSS))
+        {
+            start = false;
+        }
+        cand++;
+        address = address + length > next ? next : address + length;
+    }
+    free(candidates);
+}
+
+// Decodes only backwards from each candidate, at every halfword offset, so
+// unintended gadgets are found too. An instruction can be preceded by a
+// compressed one 2 bytes before or by a 32-bit one 4 bytes before; both
+// are followed. Decoded addresses are shared by all the walks
+static void scanBackward(const uint8_t *code, Elf32_Addr base, size_t size)
+{
+    struct backward_t walk;
+    ins32_t *path[MAX_DEPTH + 1];
+    struct branch_t tests[MAX_DEPTH + 1];
+    uint32_t *candidates;
+    size_t nCandidates, cand;
+
+    nCandidates = findTerminators(code, size, &candidates);
+    walk.code = code;
+    walk.base = base;
+    walk.end = base + size;
+    walk.path = path;
+    walk.tests = tests;
+    walk.decoded = (ins32_t **)calloc(size / 2 + 1, sizeof(ins32_t *));
+    walk.distance = (uint16_t *)malloc((size / 2 + 1) * sizeof(uint16_t));
+    walk.branches = NULL;
+    walk.nBranches = 0;
+    walk.edges = NULL;
+
+    // Each branch gets a record per way out of it: not taken and taken
+    if (args.options & OPT_BRANCH)
+    {
+        walk.nBranches = findBranches(code, size, &walk.branches);
+        walk.edges = (ins32_t **)calloc(2 * (size / 2 + 1), sizeof(ins32_t *));
+    }
+
+    if (!walk.decoded || !walk.distance || ((args.options & OPT_BRANCH) && !walk.edges))
+    {
+        fprintf(stderr, "[-] Not enough memory for the backward scan\n");
+        goto end;
+    }
+    memset(walk.distance, 0xff, (size / 2 + 1) * sizeof(uint16_t));
+
+    for (cand = 0; cand < nCandidates; cand++)
+    {
+        path[0] = lookupInstruction(&walk, base + candidates[cand]);
+
+        if (!path[0] || !endsGadget(path[0]))
+        {
+            continue;
+        }
+        walk.terminator = path[0]->operation;
+        walk.length = maxGadgetLength(walk.terminator);
+        // Pivots don't need a lw ra, they may come from a new stack
+        walk.toStart = (RET == walk.terminator) && (PIVOT_MODE != args.mode);
+        walkBack(&walk, base + candidates[cand], 1);
+    }
+
+end:
+    free(walk.decoded);
+    free(walk.distance);
+    free(walk.branches);
+    free(walk.edges);
+    free(candidates);
+}
+
+// Decoded and classified instruction at address, NULL if it doesn't fit
+static ins32_t *lookupInstruction(struct backward_t *walk, Elf32_Addr address)
+{
+    ins32_t **slot = &walk->decoded[(address - walk->base) / 2];
+    uint16_t half = walk->code[address - walk->base] | (walk->code[address - walk->base + 1] << 8);
+    struct fields_t fields;
+
+    if (!*slot && (0x3 != (half & 0x3) || address + 4 <= walk->end))
+    {
+        fields.word[0] = tableWord(fetchWord(walk->code, walk->base, walk->end, address));
+        fields.count = 1;
+        extractFields(&fields);
+        *slot = decodeClassified(walk->code, walk->base, walk->end, address, &fields, 0);
+    }
+    return *slot;
+}
+
+// Fewest instructions from address back to the start of a RET gadget
+// (lw ra). Anything over budget is reported as budget + 1. The memo keeps
+// either the exact distance or a bound, DISTANCE_FAR | n meaning "over n"
+static uint16_t startDistance(struct backward_t *walk, Elf32_Addr address, uint16_t budget)
+{
+    uint16_t *memo = &walk->distance[(address - walk->base) / 2];
+    ins32_t *instruction;
+    uint16_t res, best;
+    Elf32_Addr from;
+    size_t edge = 0;
+    bool taken;
+    step_t step;
+
+    if (DISTANCE_UNKNOWN != *memo)
+    {
+        if (!(*memo & DISTANCE_FAR))
+        {
+            return *memo <= budget ? *memo : budget + 1;
+        }
+
+        if ((*memo & ~DISTANCE_FAR) >= budget)
+        {
+            return budget + 1;
+        }
+    }
+    instruction = lookupInstruction(walk, address);
+    step = instruction ? walkStep(instruction) : STEP_STOP;
+
+    if (STEP_START == step)
+    {
+        *memo = 0;
+        return 0;
+    }
+    best = budget + 1;
+
+    while (STEP_CONTINUE == step && budget && nextEdge(walk, address, &edge, &from, &taken))
+    {
+        if ((res = startDistance(walk, from, budget - 1)) + 1 < best)
+        {
+            best = res + 1;
+        }
+    }
+    *memo = best <= budget ? best : (DISTANCE_FAR | (STEP_STOP == step ? MAX_DEPTH + 1 : budget));
+    return best;
+}
+
+static bool hasPredecessor(struct backward_t *walk, Elf32_Addr address, uint8_t length)
+{
+    uint16_t half;
+
+    if (address < walk->base + length)
+    {
+        return false;
+    }
+    half = walk->code[address - length - walk->base] | (walk->code[address - length - walk->base + 1] << 8);
+    return (4 == length) == (0x3 == (half & 0x3));
+}
+
+// Ways execution can reach address, one per call: falling through from 2 or
+// 4 bytes before and, with -b, every branch taken to it. edge starts at 0
+static bool nextEdge(struct backward_t *walk, Elf32_Addr address, size_t *edge, Elf32_Addr *from, bool *taken)
+{
+    uint32_t target = address - walk->base;
+    size_t low, high, middle;
+
+    *taken = false;
+
+    while (*edge < 2)
+    {
+        *from = address - 2 * (*edge + 1);
+
+        if (hasPredecessor(walk, address, 2 * (*edge)++ + 2))
+        {
+            return true;
+        }
+    }
+
+    // The branches are sorted by target: the first one is looked up once,
+    // edge keeps the index of the next one from there on
+    if (2 == *edge)
+    {
+        low = 0;
+        high = walk->nBranches;
+
+        while (low < high)
+        {
+            middle = low + (high - low) / 2;
+
+            if (walk->branches[middle].target < target)
+            {
+                low = middle + 1;
+            }
+
+            else
+            {
+                high = middle;
+            }
+        }
+        *edge = low + 3;
+    }
+
+    if (*edge - 3 < walk->nBranches && target == walk->branches[*edge - 3].target)
+    {
+        *from = walk->base + walk->branches[*edge - 3].source;
+        *taken = true;
+        (*edge)++;
+        return true;
+    }
+    return false;
+}
+
+// Record for the instruction at from as seen on the way out of it. Branches
+// get one per direction, telling what has to hold to go that way, and leave
+// in branch the condition, funct3 being the operator that holds
+static ins32_t *edgeInstruction(struct backward_t *walk, Elf32_Addr from, bool taken, struct branch_t *branch)
+{
+    // Indexed by funct3, the opposite condition is at funct3 ^ 1
+    static const char *operators[8] = {"==", "!=", NULL, NULL, "<", ">=", "<u", ">=u"};
+    ins32_t *instruction = lookupInstruction(walk, from), **slot;
+    char condition[32];
+
+    if (!instruction || !(args.options & OPT_BRANCH) || CMP != instruction->operation)
+    {
+        return taken ? NULL : instruction;
+    }
+
+    if (!decodeBranch(walk->code, from - walk->base, walk->end - walk->base, branch))
+    {
+        return NULL;
+    }
+
+    // Both ways lead to the next instruction, nothing has to hold
+    if (branch->target == from - walk->base + (instruction->isCompressed ? 2 : 4))
+    {
+        return taken ? NULL : instruction;
+    }
+    branch->funct3 ^= !taken;
+    slot = &walk->edges[2 * ((from - walk->base) / 2) + taken];
+
+    if (!*slot)
+    {
+        snprintf(condition, sizeof(condition), "%s %s %s", registerNames[branch->rs1], operators[branch->funct3],
+                 branch->rs2 ? registerNames[branch->rs2] : "0");
+        *slot = newInstruction();
+        **slot = *instruction;
+        (*slot)->condition = newText(condition);
+    }
+    return *slot;
+}
+
+// Whether the condition at depth can't hold along with the ones after it.
+// Only conditions on the same registers are compared, and only up to the
+// first instruction writing one of them
+static bool contradicts(struct backward_t *walk, uint16_t depth)
+{
+    const struct branch_t *test = &walk->tests[depth];
+    uint16_t i;
+    uint8_t rd;
+
+    for (i = depth - 1; i > 0; i--)
+    {
+        if (walk->path[i]->condition && test->rs1 == walk->tests[i].rs1 && test->rs2 == walk->tests[i].rs2 &&
+            excludes(test->funct3, walk->tests[i].funct3))
+        {
+            return true;
+        }
+        rd = walk->path[i]->rd;
+
+        if (rd && (rd == test->rs1 || rd == test->rs2))
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Operators by funct3: one is the negation of the other, or == against <
+static inline bool excludes(uint8_t first, uint8_t second)
+{
+    return (first == (second ^ 1)) || (0 == first && (4 == second || 6 == second)) ||
+           (0 == second && (4 == first || 6 == first));
+}
+
+// Extends the path with every possible predecessor of address. Each
+// finished path goes through the usual filters
+static void walkBack(struct backward_t *walk, Elf32_Addr address, uint16_t depth)
+{
+    Elf32_Addr from;
+    size_t edge = 0;
+    bool taken, extended = false;
+    step_t step;
+
+    while (nextEdge(walk, address, &edge, &from, &taken))
+    {
+        if (!(walk->path[depth] = edgeInstruction(walk, from, taken, &walk->tests[depth])))
+        {
+            continue;
+        }
+
+        // a0 != 0 first and a0 == 0 later: no way to run it
+        if (walk->path[depth]->condition && contradicts(walk, depth))
+        {
+            continue;
+        }
+
+        // RET gadgets only exist up to a lw ra, skip the paths that never get there
+        if (walk->toStart &&
+            (startDistance(walk, from, walk->length - 1 - depth) > walk->length - 1 - depth))
+        {
+            continue;
+        }
+        step = walkStep(walk->path[depth]);
+        extended = true;
+
+        if ((STEP_CONTINUE == step || (STEP_START == step && !walk->toStart)) &&
+            depth + 1 < walk->length)
+        {
+            walkBack(walk, from, depth + 1);
+        }
+
+        else
+        {
+            emitPath(walk, depth + 1);
+        }
+    }
+
+    // Nothing can be decoded in front of it
+    if (!extended && !walk->toStart)
+    {
+        emitPath(walk, depth);
+    }
+}
+
+// Lays the path out as a region of its own, oldest first, and runs the
+// filters on it
+static void emitPath(struct backward_t *walk, uint16_t length)
+{
+    size_t last = 0;
+
+    newRegion();
+
+    while (length)
+    {
+        last = pushToRegion(walk->path[--length]);
+    }
+    processGadgets(last, walk->terminator);
+}
+
+size_t fillData(struct ins32_t *instruction)
+{
+    classifyInstruction(instruction);
+    return pushToRegion(instruction);
+}
+
+static void classifyInstruction(struct ins32_t *instruction)
+{
+    char start = instruction->disassembled[0];
+
+    if (setBitmanipData(instruction))
+    {
+        setRegisters(instruction);
+        return;
+    }
+
+    switch (start)
+    {
+    case 'l':
+        if (0 == strncmp(instruction->disassembled, "lpad", 4))
+        {
+            instruction->operation = LPAD;
+        }
+
+        // lr.w/lr.d included: a plain load that also sets a reservation
+        else
+        {
+            instruction->operation = LOAD;
+            setInmediate(instruction);
+        }
+        instruction->useImmediate = false;
+
+        // li and lui load their immediate, the rest keep their offset there
+        if (0 == strncmp(instruction->disassembled, "li\t", 3))
+        {
+            instruction->useImmediate = true;
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "lui\t", 4))
+        {
+            instruction->useImmediate = true;
+            instruction->immediate = (int32_t)((uint32_t)instruction->immediate << 12);
+        }
+        break;
+
+    case 'b':
+        instruction->operation = CMP;
+        instruction->useImmediate = false;
+        break;
+
+    case 'j':
+    case 't':
+        if (strstr(instruction->disassembled, "jal"))
+        {
+            instruction->operation = CALL;
+        }
+
+        else
+        {
+            instruction->operation = JMP;
+        }
+
+        // jr 12(t0), not the target of a jal
+        if (strchr(instruction->disassembled, '('))
+        {
+            setInmediate(instruction);
+        }
+
+        instruction->useImmediate = false;
+        break;
+
+    case 'o':
+    case 'x':
+        instruction->operation = OR;
+        if (strstr(instruction->disassembled, "i"))
+        {
+            instruction->useImmediate = true;
+            setInmediate(instruction);
         }
 
-        else if (strstr(instruction->disassembled, "g"))
+        else
+        {
+            instruction->useImmediate = false;
+        }
+        break;
+
+    case 'e':
+        if (strstr(instruction->disassembled, "ecall"))
+        {
+            instruction->operation = SYSCALL;
+        }
+
+        else
+        {
+            instruction->operation = BRK;
+        }
+        instruction->useImmediate = false;
+        break;
+
+    case 'r':
+        if (0 == strncmp(instruction->disassembled, "rem", 3))
+        {
+            instruction->operation = MUL;
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "rd", 2))
+        {
+            // rdcycle, rdtime and rdinstret read counters
+            instruction->operation = CSR;
+        }
+
+        else
+        {
+            instruction->operation = RET;
+        }
+        instruction->useImmediate = false;
+        break;
+
+    case 'n':
+        if (0 == strncmp(instruction->disassembled, "not", 3))
+        {
+            instruction->operation = NOT;
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "neg", 3))
         {
             instruction->operation = NEG;
         }
@@ -471,7 +1645,13 @@ uint8_t fillData(struct ins32_t *instruction)
         break;
 
     case 'm':
-        if (!strstr(instruction->disassembled, "mul"))
+        if (0 == strncmp(instruction->disassembled, "mret", 4))
+        {
+            instruction->operation = ERET;
+            instruction->isPrivileged = true;
+        }
+
+        else if (!strstr(instruction->disassembled, "mul"))
         {
             instruction->operation = MOV;
         }
@@ -484,7 +1664,14 @@ uint8_t fillData(struct ins32_t *instruction)
         break;
 
     case 'a':
-        if (!strstr(instruction->disassembled, ".w"))
+        // Toolchains without Zicfilp print lpad as its encoding, auipc x0
+        if (0 == strncmp(instruction->disassembled, "auipc\tzero,", 11))
+        {
+            instruction->operation = LPAD;
+            instruction->useImmediate = false;
+        }
+
+        else if (0 != strncmp(instruction->disassembled, "amo", 3))
         {
             if (strstr(instruction->disassembled, "ad") || strstr(instruction->disassembled, "au"))
             {
@@ -508,6 +1695,7 @@ uint8_t fillData(struct ins32_t *instruction)
             }
         }
 
+        // AMOs: rd gets the old value of mem[rs1], which is updated using rs2
         else
         {
             instruction->operation = ATOMIC;
@@ -516,12 +1704,31 @@ uint8_t fillData(struct ins32_t *instruction)
         break;
 
     case 'f':
-        instruction->operation = IO;
+        setFloatData(instruction);
         instruction->useImmediate = false;
         break;
 
     case 's':
-        if (!strstr(instruction->disassembled, ".w"))
+        if (0 == strncmp(instruction->disassembled, "ss", 2))
+        {
+            setShadowStackData(instruction);
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "sret", 4))
+        {
+            instruction->operation = ERET;
+            instruction->isPrivileged = true;
+            instruction->useImmediate = false;
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "sfence", 6))
+        {
+            instruction->operation = NOP;
+            instruction->isPrivileged = true;
+            instruction->useImmediate = false;
+        }
+
+        else if (0 != strncmp(instruction->disassembled, "sc.", 3))
         {
             if (strstr(instruction->disassembled, "sub"))
             {
@@ -564,9 +1771,11 @@ uint8_t fillData(struct ins32_t *instruction)
             {
                 instruction->operation = STORE;
                 instruction->useImmediate = false;
+                setInmediate(instruction);
             }
         }
 
+        // sc.w/sc.d write rs2 to mem[rs1] and the success code to rd
         else
         {
             instruction->operation = ATOMIC;
@@ -579,54 +1788,323 @@ uint8_t fillData(struct ins32_t *instruction)
         instruction->useImmediate = false;
         break;
 
+    case 'v':
+        setVectorData(instruction);
+        instruction->useImmediate = false;
+        break;
+
+    case 'w':
+        if (0 == strncmp(instruction->disassembled, "wfi", 3))
+        {
+            instruction->operation = NOP;
+            instruction->isPrivileged = true;
+        }
+
+        else
+        {
+            instruction->operation = UNSUPORTED;
+        }
+        instruction->useImmediate = false;
+        break;
+
+    case 'c':
+        if (0 == strncmp(instruction->disassembled, "c.ss", 4))
+        {
+            setShadowStackData(instruction);
+        }
+
+        else if (0 == strncmp(instruction->disassembled, "csr", 3))
+        {
+            setCsrData(instruction);
+        }
+
+        else
+        {
+            instruction->operation = UNSUPORTED;
+        }
+        break;
+
     default:
         instruction->operation = UNSUPORTED;
         break;
     }
 
-    setRegDest(instruction);
-    return pushToPGL(instruction);
+    setRegisters(instruction);
 }
 
+// The immediate is the last operand, in decimal or 0x-prefixed hex. An
+// offset(reg) operand gives its offset
 static void setInmediate(struct ins32_t *instruction)
 {
-    char buf[16];
-    memset(buf, 0x0, 16);
-    size_t size;
-    size_t startPos = strlen(instruction->disassembled) - 1;
-    char *isPresent = strstr(instruction->disassembled, "0x");
+    const char *operand = strrchr(instruction->disassembled, ',');
 
-    if (isPresent)
+    if (!operand)
     {
-        isPresent++;
-        isPresent++;
-        size = strlen(isPresent);
-        memcpy(buf, isPresent, size);
-        instruction->immediate = atoi(buf);
-        return;
+        operand = strchr(instruction->disassembled, '\t');
     }
 
-    while (',' != instruction->disassembled[startPos - 1])
+    instruction->immediate = operand ? strtol(operand + 1, NULL, 0) : 0;
+}
+
+static void setFloatData(struct ins32_t *instruction)
+{
+    // Anything not listed is an extension we don't model and stays as IO
+    const mnemonic_class_t *entry = floatClasses;
+
+    while (entry->prefix &&
+           strncmp(instruction->disassembled, entry->prefix, strlen(entry->prefix)))
     {
-        startPos--;
+        entry++;
     }
-    size = strlen(&instruction->disassembled[startPos]);
-    memcpy(buf, &instruction->disassembled[startPos], size);
-    instruction->immediate = atoi(buf);
+    instruction->operation = entry->operation;
 }
 
-static inline void setRegDest(struct ins32_t *instruction)
+static void setShadowStackData(struct ins32_t *instruction)
 {
-    if ((CMP == instruction->operation) || (BRK == instruction->operation) ||
-        (RET == instruction->operation) || (ATOMIC == instruction->operation) ||
-        (IO == instruction->operation) || (SYSCALL == instruction->operation) ||
-        (NOP == instruction->operation) ||
-        (UNSUPORTED == instruction->operation))
+    // Zicfiss: sspush, sspopchk (and their c. forms), ssrdp and ssamoswap
+    const char *mnemonic = instruction->disassembled;
+
+    if (0 == strncmp(mnemonic, "c.", 2))
     {
-        return;
+        mnemonic += 2;
+    }
+
+    if (0 == strncmp(mnemonic, "sspush", 6))
+    {
+        instruction->operation = SSPUSH;
+    }
+
+    else if (0 == strncmp(mnemonic, "sspopchk", 8))
+    {
+        instruction->operation = SSPOPCHK;
+    }
+
+    else if (0 == strncmp(mnemonic, "ssrdp", 5))
+    {
+        instruction->operation = MOV;
+    }
+
+    else
+    {
+        instruction->operation = ATOMIC;
+    }
+    instruction->useImmediate = false;
+}
+
+static bool setBitmanipData(struct ins32_t *instruction)
+{
+    const mnemonic_class_t *entry = bitmanipClasses;
+    size_t length = strcspn(instruction->disassembled, "\t ");
+
+    while (entry->prefix && ((strlen(entry->prefix) != length) ||
+                             strncmp(instruction->disassembled, entry->prefix, length)))
+    {
+        entry++;
+    }
+
+    if (!entry->prefix)
+    {
+        return false;
+    }
+    instruction->operation = entry->operation;
+    instruction->useImmediate = entry->useImmediate;
+
+    if (instruction->useImmediate)
+    {
+        setInmediate(instruction);
+    }
+    return true;
+}
+
+// Only the V memory and configuration instructions are modeled
+static void setVectorData(struct ins32_t *instruction)
+{
+    const char *m = instruction->disassembled;
+
+    if (0 == strncmp(m, "vsetvl", 6) || 0 == strncmp(m, "vsetivli", 8))
+    {
+        instruction->operation = VSETVL;
+    }
+
+    else if (0 == strncmp(m, "vl", 2))
+    {
+        instruction->operation = VLOAD;
+    }
+
+    else if ((0 == strncmp(m, "vse", 3) && isdigit(m[3])) ||
+             (0 == strncmp(m, "vsse", 4) && isdigit(m[4])) ||
+             (0 == strncmp(m, "vs", 2) && isdigit(m[2])) ||
+             0 == strncmp(m, "vsseg", 5) || 0 == strncmp(m, "vssseg", 6) ||
+             0 == strncmp(m, "vsux", 4) || 0 == strncmp(m, "vsox", 4) ||
+             0 == strncmp(m, "vsm.v", 5))
+    {
+        instruction->operation = VSTORE;
+    }
+
+    else
+    {
+        instruction->operation = UNSUPORTED;
     }
+}
+
+static void setCsrData(struct ins32_t *instruction)
+{
     char *pos = strstr(instruction->disassembled, "\t");
-    strncpy(instruction->regDest, ++pos, 2);
+    const char **name;
+    size_t length;
+    long number;
+
+    instruction->operation = CSR;
+    instruction->useImmediate = false;
+    instruction->isPrivileged = false;
+
+    // The CSR is the only operand that is neither a register nor a number
+    while (pos && *pos)
+    {
+        pos++;
+        length = strcspn(pos, ",");
+        if (isdigit(*pos) || '-' == *pos)
+        {
+            // Unnamed CSR: bits 9:8 of its number hold the lowest privilege level
+            number = strtol(pos, NULL, 0);
+            if (0x1f < number)
+            {
+                instruction->isPrivileged = 0 != (number & 0x300);
+                return;
+            }
+        }
+
+        else if (REG_NONE == parseRegister(pos, length))
+        {
+            for (name = userCsrNames; *name; name++)
+            {
+                if (0 == strncmp(pos, *name, strlen(*name)))
+                {
+                    return;
+                }
+            }
+            instruction->isPrivileged = true;
+            return;
+        }
+        pos += length;
+    }
+}
+
+static uint8_t parseRegister(const char *name, size_t length)
+{
+    uint8_t i;
+
+    if ((2 == length) && (0 == strncmp(name, "fp", 2)))
+    {
+        return 8;
+    }
+
+    for (i = 0; i < NUM_REGISTERS; i++)
+    {
+        if ((strlen(registerNames[i]) == length) &&
+            (0 == strncmp(registerNames[i], name, length)))
+        {
+            return i;
+        }
+    }
+    return REG_NONE;
+}
+
+// Fills rd, rs and regDest from the operands of the disassembled text
+static void setRegisters(struct ins32_t *instruction)
+{
+    uint8_t registers[4], nRegisters = 0, reg, i;
+    char *pos = strstr(instruction->disassembled, "\t"), *target = NULL;
+    bool hasDest;
+    size_t length;
+
+    instruction->rd = REG_NONE;
+    memset(instruction->rs, REG_NONE, sizeof(instruction->rs));
+    memset(instruction->regDest, 0x0, sizeof(instruction->regDest));
+
+    // Branch and jal/j targets are hex with no prefix, 1a4 or a0 is no register
+    if (pos && ((CMP == instruction->operation) ||
+                (((CALL == instruction->operation) || (JMP == instruction->operation)) &&
+                 ('j' == instruction->disassembled[0]) && !strstr(instruction->disassembled, "jr") &&
+                 !strstr(instruction->disassembled, "jalr"))))
+    {
+        target = strrchr(instruction->disassembled, ',') ? strrchr(instruction->disassembled, ',') : pos;
+    }
+
+    while (pos && *pos && pos != target && nRegisters < 4)
+    {
+        pos++;
+        length = strcspn(pos, ",() ");
+        reg = parseRegister(pos, length);
+        if (REG_NONE != reg)
+        {
+            registers[nRegisters++] = reg;
+        }
+        pos += length;
+    }
+
+    switch (instruction->operation)
+    {
+    case STORE:
+    case VSTORE:
+    case CMP:
+    case JMP:
+    case SYSCALL:
+    case BRK:
+    case NOP:
+    case LPAD:
+    case SSPUSH:
+    case SSPOPCHK:
+        hasDest = false;
+        break;
+
+    case RET:
+        registers[0] = 1; // ra
+        nRegisters = 1;
+        hasDest = false;
+        break;
+
+    case ERET:
+        hasDest = false;
+        break;
+
+    case CALL:
+        // jal and jalr link through ra unless another register is given
+        hasDest = strstr(instruction->disassembled, "jalr") ? (2 == nRegisters) : (1 == nRegisters);
+        if (!hasDest && nRegisters < 4)
+        {
+            memmove(&registers[1], registers, nRegisters);
+            registers[0] = 1;
+            nRegisters++;
+            hasDest = true;
+        }
+        break;
+
+    case IO:
+    case CSR:
+        // csrr*, frcsr, rdcycle, ... read into rd. csrw/fscsr with a single
+        // register only write the CSR
+        hasDest = (nRegisters >= 2) || (0 == strncmp(instruction->disassembled, "csrr", 4)) ||
+                  (0 == strncmp(instruction->disassembled, "fr", 2)) ||
+                  (0 == strncmp(instruction->disassembled, "rd", 2));
+        break;
+
+    default:
+        hasDest = nRegisters > 0;
+        break;
+    }
+
+    i = 0;
+    if (hasDest && nRegisters)
+    {
+        instruction->rd = registers[i++];
+        strcpy(instruction->regDest, registerNames[instruction->rd]);
+    }
+
+    for (; i < nRegisters && (i - hasDest) < 3; i++)
+    {
+        instruction->rs[i - hasDest] = registers[i];
+    }
 }
 
 static inline void removeExtraInfo(struct ins32_t *instruction)
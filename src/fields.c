@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "decoder.h"
+#include "fields.h"
+
+// Rows of the class table picked by funct7 (R-type and shifts only)
+#define VARIANT_BASE 0
+#define VARIANT_MULDIV 1
+#define VARIANT_ALT 2
+#define VARIANT_NONE 3
+
+// How the operands are laid out in the text fillData() would parse
+typedef enum
+{
+    SHAPE_NONE,
+    SHAPE_LOAD,
+    SHAPE_STORE,
+    SHAPE_BRANCH,
+    SHAPE_JAL,
+    SHAPE_JALR,
+    SHAPE_LUI,
+    SHAPE_AUIPC,
+    SHAPE_ADDI,
+    SHAPE_IMM,
+    SHAPE_SHIFT,
+    SHAPE_REG
+} shape_t;
+
+typedef struct field_class_t
+{
+    op_t operation;
+    shape_t shape;
+} field_class_t;
+
+// Indexed by variant, major opcode (bits 6:2) and funct3. Entries left out
+// have SHAPE_NONE and go through the text classification
+static const field_class_t classes[3][32][8] = {
+    [VARIANT_BASE] = {
+        [0x03 >> 2] = {{LOAD, SHAPE_LOAD}, {LOAD, SHAPE_LOAD}, {LOAD, SHAPE_LOAD}, [4] = {LOAD, SHAPE_LOAD}, {LOAD, SHAPE_LOAD}},
+        [0x13 >> 2] = {{ADD, SHAPE_ADDI}, {SHIFT, SHAPE_SHIFT}, {SET, SHAPE_IMM}, {SET, SHAPE_IMM}, {OR, SHAPE_IMM}, {SHIFT, SHAPE_SHIFT}, {OR, SHAPE_IMM}, {AND, SHAPE_IMM}},
+        [0x17 >> 2] = {[0 ... 7] = {ADD, SHAPE_AUIPC}},
+        [0x23 >> 2] = {{STORE, SHAPE_STORE}, {STORE, SHAPE_STORE}, {STORE, SHAPE_STORE}},
+        [0x33 >> 2] = {{ADD, SHAPE_REG}, {SHIFT, SHAPE_REG}, {SET, SHAPE_REG}, {SET, SHAPE_REG}, {OR, SHAPE_REG}, {SHIFT, SHAPE_REG}, {OR, SHAPE_REG}, {AND, SHAPE_REG}},
+        [0x37 >> 2] = {[0 ... 7] = {LOAD, SHAPE_LUI}},
+        [0x63 >> 2] = {{CMP, SHAPE_BRANCH}, {CMP, SHAPE_BRANCH}, [4] = {CMP, SHAPE_BRANCH}, {CMP, SHAPE_BRANCH}, {CMP, SHAPE_BRANCH}, {CMP, SHAPE_BRANCH}},
+        [0x67 >> 2] = {{CALL, SHAPE_JALR}},
+        [0x6f >> 2] = {[0 ... 7] = {CALL, SHAPE_JAL}},
+    },
+    [VARIANT_MULDIV] = {
+        [0x33 >> 2] = {{MUL, SHAPE_REG}, {MUL, SHAPE_REG}, {MUL, SHAPE_REG}, {MUL, SHAPE_REG}, {DIV, SHAPE_REG}, {DIV, SHAPE_REG}, {MUL, SHAPE_REG}, {MUL, SHAPE_REG}},
+    },
+    [VARIANT_ALT] = {
+        [0x13 >> 2] = {[5] = {SHIFT, SHAPE_SHIFT}},
+        [0x33 >> 2] = {{SUB, SHAPE_REG}, [5] = {SHIFT, SHAPE_REG}},
+    },
+};
+
+// Bit funct3 set means funct7 picks the row for that major opcode/funct3
+static const uint8_t usesFunct7[32] = {
+    [0x13 >> 2] = (1 << 1) | (1 << 5),
+    [0x33 >> 2] = 0xff,
+};
+
+// Vector part of the extraction, returns how many words it covered
+typedef size_t (*extractor_t)(struct fields_t *fields);
+
+static void extractScalar(struct fields_t *fields, size_t start);
+
+static size_t extractNone(struct fields_t *fields);
+
+static extractor_t pickExtractor(void);
+
+#if defined(__x86_64__) || defined(__i386__)
+static size_t extractSse2(struct fields_t *fields);
+
+static size_t extractAvx2(struct fields_t *fields);
+#endif
+
+static uint8_t variantOf(uint8_t funct7);
+
+static void setOperands(struct ins32_t *instruction, bool hasDest, const uint8_t *registers, uint8_t nRegisters);
+
+static void extractScalar(struct fields_t *fields, size_t start)
+{
+    size_t i;
+    uint32_t word;
+
+    for (i = start; i < fields->count; i++)
+    {
+        word = fields->word[i];
+        fields->opcode[i] = word & 0x7f;
+        fields->rd[i] = (word >> 7) & 0x1f;
+        fields->funct3[i] = (word >> 12) & 0x7;
+        fields->rs1[i] = (word >> 15) & 0x1f;
+        fields->rs2[i] = (word >> 20) & 0x1f;
+        fields->funct7[i] = word >> 25;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 4 words per step. Every field fits in a byte, so two saturating packs
+// narrow the 32-bit lanes without losing anything
+__attribute__((target("sse2"))) static size_t extractSse2(struct fields_t *fields)
+{
+    const __m128i opcodeMask = _mm_set1_epi32(0x7f), regMask = _mm_set1_epi32(0x1f);
+    const __m128i funct3Mask = _mm_set1_epi32(0x7);
+    __m128i words, field;
+    int32_t packed;
+    size_t i;
+
+#define STORE_FIELD(array, value)                                     \
+    field = _mm_packs_epi32((value), (value));                         \
+    packed = _mm_cvtsi128_si32(_mm_packus_epi16(field, field));        \
+    memcpy(&fields->array[i], &packed, 4)
+
+    for (i = 0; i + 4 <= fields->count; i += 4)
+    {
+        words = _mm_loadu_si128((const __m128i *)&fields->word[i]);
+        STORE_FIELD(opcode, _mm_and_si128(words, opcodeMask));
+        STORE_FIELD(rd, _mm_and_si128(_mm_srli_epi32(words, 7), regMask));
+        STORE_FIELD(funct3, _mm_and_si128(_mm_srli_epi32(words, 12), funct3Mask));
+        STORE_FIELD(rs1, _mm_and_si128(_mm_srli_epi32(words, 15), regMask));
+        STORE_FIELD(rs2, _mm_and_si128(_mm_srli_epi32(words, 20), regMask));
+        STORE_FIELD(funct7, _mm_srli_epi32(words, 25));
+    }
+
+#undef STORE_FIELD
+    return i;
+}
+
+// 8 words per step. The low byte of every lane is shuffled to the front of
+// its 128-bit half and both halves are then joined
+__attribute__((target("avx2"))) static size_t extractAvx2(struct fields_t *fields)
+{
+    const __m256i opcodeMask = _mm256_set1_epi32(0x7f), regMask = _mm256_set1_epi32(0x1f);
+    const __m256i funct3Mask = _mm256_set1_epi32(0x7);
+    const __m256i lowBytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    __m256i words, field;
+    size_t i;
+
+#define STORE_FIELD(array, value)                                                         \
+    field = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8((value), lowBytes), join);     \
+    _mm_storel_epi64((__m128i *)&fields->array[i], _mm256_castsi256_si128(field))
+
+    for (i = 0; i + 8 <= fields->count; i += 8)
+    {
+        words = _mm256_loadu_si256((const __m256i *)&fields->word[i]);
+        STORE_FIELD(opcode, _mm256_and_si256(words, opcodeMask));
+        STORE_FIELD(rd, _mm256_and_si256(_mm256_srli_epi32(words, 7), regMask));
+        STORE_FIELD(funct3, _mm256_and_si256(_mm256_srli_epi32(words, 12), funct3Mask));
+        STORE_FIELD(rs1, _mm256_and_si256(_mm256_srli_epi32(words, 15), regMask));
+        STORE_FIELD(rs2, _mm256_and_si256(_mm256_srli_epi32(words, 20), regMask));
+        STORE_FIELD(funct7, _mm256_srli_epi32(words, 25));
+    }
+
+#undef STORE_FIELD
+    return i;
+}
+#endif
+
+static size_t extractNone(struct fields_t *fields)
+{
+    (void)fields;
+    return 0;
+}
+
+static extractor_t pickExtractor(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return extractAvx2;
+    }
+
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        return extractSse2;
+    }
+#endif
+    return extractNone;
+}
+
+void extractFields(struct fields_t *fields)
+{
+    // The CPU doesn't change, it is only looked at the first time
+    static extractor_t extractor = NULL;
+
+    if (NULL == extractor)
+    {
+        extractor = pickExtractor();
+    }
+
+    // Less than a vector of words is done faster one by one
+    extractScalar(fields, fields->count >= 4 ? extractor(fields) : 0);
+}
+
+static uint8_t variantOf(uint8_t funct7)
+{
+    switch (funct7)
+    {
+    case 0x00:
+        return VARIANT_BASE;
+
+    case 0x01:
+        return VARIANT_MULDIV;
+
+    case 0x20:
+        return VARIANT_ALT;
+
+    default:
+        return VARIANT_NONE;
+    }
+}
+
+// Registers in the order the text lists them. With hasDest the first one is rd
+static void setOperands(struct ins32_t *instruction, bool hasDest, const uint8_t *registers, uint8_t nRegisters)
+{
+    uint8_t i = 0;
+
+    instruction->rd = REG_NONE;
+    memset(instruction->rs, REG_NONE, sizeof(instruction->rs));
+    memset(instruction->regDest, 0x0, sizeof(instruction->regDest));
+
+    if (hasDest && nRegisters)
+    {
+        instruction->rd = registers[i++];
+        strcpy(instruction->regDest, registerNames[instruction->rd]);
+    }
+
+    for (; i < nRegisters && (i - hasDest) < 3; i++)
+    {
+        instruction->rs[i - hasDest] = registers[i];
+    }
+}
+
+bool classifyFields(const struct fields_t *fields, size_t index, struct ins32_t *instruction)
+{
+    uint8_t opcode = fields->opcode[index], rd = fields->rd[index], funct3 = fields->funct3[index];
+    uint8_t rs1 = fields->rs1[index], rs2 = fields->rs2[index], variant = VARIANT_BASE;
+    uint8_t registers[4], nRegisters = 0;
+    uint32_t word = fields->word[index];
+    int32_t immediate = (int32_t)word >> 20;
+    const field_class_t *entry;
+    bool hasDest = true;
+
+    if (0x3 != (opcode & 0x3))
+    {
+        return false;
+    }
+
+    if (usesFunct7[opcode >> 2] & (1 << funct3))
+    {
+        variant = variantOf(fields->funct7[index]);
+
+        if (VARIANT_NONE == variant)
+        {
+            return false;
+        }
+    }
+    entry = &classes[variant][opcode >> 2][funct3];
+
+    // auipc zero is lpad and andi 255 is zext.b
+    if ((SHAPE_NONE == entry->shape) || (SHAPE_AUIPC == entry->shape && !rd) ||
+        (SHAPE_IMM == entry->shape && 7 == funct3 && 0xff == immediate))
+    {
+        return false;
+    }
+    instruction->operation = entry->operation;
+    instruction->useImmediate = false;
+
+    // Loads, stores and jalr keep their offset in immediate
+    switch (entry->shape)
+    {
+    case SHAPE_LOAD:
+        instruction->immediate = immediate;
+        registers[nRegisters++] = rd;
+        registers[nRegisters++] = rs1;
+        break;
+
+    case SHAPE_STORE:
+        hasDest = false;
+        instruction->immediate = ((int32_t)(word & 0xfe000000) >> 20) | rd;
+        registers[nRegisters++] = rs2;
+        registers[nRegisters++] = rs1;
+        break;
+
+    // beqz, bnez, bltz, bgez, blez and bgtz leave out the zero register
+    case SHAPE_BRANCH:
+        hasDest = false;
+
+        if ((5 == funct3 && !rs1) || (4 == funct3 && rs2 && !rs1))
+        {
+            registers[nRegisters++] = rs2;
+        }
+
+        else if (!rs2 && funct3 < 6)
+        {
+            registers[nRegisters++] = rs1;
+        }
+
+        else
+        {
+            registers[nRegisters++] = rs1;
+            registers[nRegisters++] = rs2;
+        }
+        break;
+
+    // j and jal print no register for x0 and ra. jal links through ra unless
+    // it is given just one register
+    case SHAPE_JAL:
+        if (rd > 1)
+        {
+            registers[nRegisters++] = rd;
+        }
+
+        if (!rd)
+        {
+            instruction->operation = JMP;
+            hasDest = false;
+        }
+
+        else if (1 != nRegisters)
+        {
+            memmove(&registers[1], registers, nRegisters++);
+            registers[0] = 1;
+        }
+        break;
+
+    case SHAPE_JALR:
+        if (0x00008067 == word)
+        {
+            instruction->operation = RET;
+            hasDest = false;
+            registers[nRegisters++] = 1;
+        }
+
+        else if (rd)
+        {
+            instruction->immediate = immediate;
+            registers[nRegisters++] = rd;
+            registers[nRegisters++] = rs1;
+        }
+
+        else
+        {
+            instruction->operation = JMP;
+            instruction->immediate = immediate;
+            hasDest = false;
+            registers[nRegisters++] = rs1;
+        }
+        break;
+
+    // li and lui are loads of the value in their immediate
+    case SHAPE_LUI:
+        instruction->useImmediate = true;
+        instruction->immediate = (int32_t)(word & 0xfffff000);
+        registers[nRegisters++] = rd;
+        break;
+
+    case SHAPE_AUIPC:
+        instruction->useImmediate = true;
+        instruction->immediate = word >> 12;
+        registers[nRegisters++] = rd;
+        break;
+
+    // nop, li, mv and addi
+    case SHAPE_ADDI:
+        if (0x00000013 == word)
+        {
+            instruction->operation = NOP;
+            hasDest = false;
+            break;
+        }
+        registers[nRegisters++] = rd;
+
+        if (!rs1)
+        {
+            instruction->operation = LOAD;
+            instruction->useImmediate = true;
+            instruction->immediate = immediate;
+            break;
+        }
+        registers[nRegisters++] = rs1;
+
+        if (!immediate)
+        {
+            instruction->operation = MOV;
+        }
+
+        else
+        {
+            instruction->useImmediate = true;
+            instruction->immediate = immediate;
+        }
+        break;
+
+    // seqz and not take no immediate
+    case SHAPE_IMM:
+        if ((3 == funct3 && 1 == immediate) || (4 == funct3 && -1 == immediate))
+        {
+            instruction->operation = 3 == funct3 ? SET : NOT;
+        }
+
+        else
+        {
+            instruction->useImmediate = true;
+            instruction->immediate = immediate;
+        }
+        registers[nRegisters++] = rd;
+        registers[nRegisters++] = rs1;
+        break;
+
+    case SHAPE_SHIFT:
+        instruction->useImmediate = true;
+        instruction->immediate = rs2;
+        registers[nRegisters++] = rd;
+        registers[nRegisters++] = rs1;
+        break;
+
+    // neg, sltz, sgtz and snez leave out the zero register
+    case SHAPE_REG:
+        registers[nRegisters++] = rd;
+
+        if (SUB == instruction->operation && !rs1)
+        {
+            instruction->operation = NEG;
+            registers[nRegisters++] = rs2;
+        }
+
+        else if (VARIANT_BASE == variant && 2 == funct3 && !rs2)
+        {
+            registers[nRegisters++] = rs1;
+        }
+
+        else if (VARIANT_BASE == variant && 2 <= funct3 && funct3 <= 3 && !rs1)
+        {
+            registers[nRegisters++] = rs2;
+        }
+
+        else
+        {
+            registers[nRegisters++] = rs1;
+            registers[nRegisters++] = rs2;
+        }
+        break;
+
+    default:
+        break;
+    }
+    setOperands(instruction, hasDest, registers, nRegisters);
+    return true;
+}
@@ -23,88 +23,159 @@
 #include <unistd.h>
 
 #include "datatypes.h"
+#include "decoder.h"
+#include "disas.h"
 #include "gadget.h"
+#include "transfer.h"
 
-#define MAX_LENGTH_NO_RET 6
+static struct trie_t *last = NULL;
 
-static struct node_t *last = NULL;
+static struct gadget_t *newGadget(struct ins32_t *terminator, uint16_t capacity);
 
-static struct node_t *lastSp = NULL;
+static void pushInstruction(struct gadget_t *gadget, struct ins32_t *instruction);
 
-static char *prettifyString(char *src);
+static void cutGadget(struct gadget_t *gadget, uint16_t length);
 
-static struct gadget_t *retFilter(uint16_t lastElement);
+static struct gadget_t *retFilter(size_t lastElement);
 
 static struct gadget_t *jopFilter(struct gadget_t *gadget);
 
-static struct gadget_t *noRetFilter(uint16_t lastElement);
+static struct gadget_t *noRetFilter(size_t lastElement, uint16_t maxLength);
 
-static char *generateKey(struct gadget_t *gadget);
+static struct gadget_t *pivotFilter(struct gadget_t *gadget);
 
-static char *updateKey(char *key);
+static int16_t findPivot(struct gadget_t *gadget);
+
+static bool describePivot(struct ins32_t *instruction, char *buf, size_t size);
+
+static void printPivot(struct gadget_t *gadget);
+
+static struct gadget_t *dispatcherFilter(struct gadget_t *gadget);
+
+static bool findDispatcher(struct gadget_t *gadget, uint16_t *start, uint8_t *base, int16_t *stride);
+
+static value_t syscallNumber(struct gadget_t *gadget, int32_t *number);
+
+static struct gadget_t *syscallFilter(struct gadget_t *gadget);
+
+static struct gadget_t *cfiFilter(struct gadget_t *gadget, op_t lastOperation);
+
+static const char *cfiStatusName(cfi_status_t status);
+
+static void printVectorLength(struct gadget_t *gadget);
+
+static bool crossedLabel(struct gadget_t *gadget, addr32_t *label);
+
+static void printConditions(struct gadget_t *gadget);
+
+static void printSyscall(struct gadget_t *gadget);
+
+static void describeFrame(struct gadget_t *gadget, struct frame_t *frame);
+
+static void printFrame(struct gadget_t *gadget);
 
 static bool checkValidity(struct ins32_t *instruction);
 
 static bool messSp(struct ins32_t *instruction);
 
+static bool isAuipc(struct ins32_t *instruction);
+
 static __attribute__((always_inline)) inline bool isLastInstruction(struct ins32_t *instruction);
 
 static inline bool isLastInstruction(struct ins32_t *instruction)
 {
-    return (LOAD == instruction->operation) &&
-           (0 == strcmp(instruction->regDest, "ra"));
+    return (LOAD == instruction->operation) && (1 == instruction->rd); // ra
 }
 
 static bool checkValidity(struct ins32_t *instruction)
 {
-    return (CMP != instruction->operation) && (JMP != instruction->operation) &&
+    return ((CMP != instruction->operation) || (args.options & OPT_BRANCH)) && (JMP != instruction->operation) &&
            (BRK != instruction->operation) && (RET != instruction->operation) &&
            (CALL != instruction->operation) &&
-           (SYSCALL != instruction->operation) &&
+           (SYSCALL != instruction->operation) && (ERET != instruction->operation) &&
+           (!instruction->isPrivileged || (args.options & OPT_KERNEL)) &&
            (UNSUPORTED != instruction->operation) &&
-           (ATOMIC != instruction->operation) && (IO != instruction->operation) &&
-           !strstr(instruction->disassembled, "auipc") && !messSp(instruction);
+           (IO != instruction->operation) &&
+           !isAuipc(instruction) && !messSp(instruction);
 }
 
 static bool messSp(struct ins32_t *instruction)
 {
-    return ((ADD == instruction->operation) && instruction->useImmediate &&
-            (instruction->immediate < 0) &&
-            strstr(instruction->disassembled, "addi\tsp")) ||
-           ((SUB == instruction->operation) &&
-            strstr(instruction->disassembled, "sub\tsp"));
+    // That is exactly what some pivots do
+    if (PIVOT_MODE == args.mode)
+    {
+        return false;
+    }
+    return (2 == instruction->rd) && // sp
+           (((ADD == instruction->operation) && instruction->useImmediate &&
+             (instruction->immediate < 0)) ||
+            (SUB == instruction->operation));
+}
+
+bool adjustsSp(struct ins32_t *instruction)
+{
+    return (ADD == instruction->operation) && instruction->useImmediate &&
+           (2 == instruction->rd) && (2 == instruction->rs[0]); // sp
+}
+
+// auipc is the only addition that reads no register
+static bool isAuipc(struct ins32_t *instruction)
+{
+    return (ADD == instruction->operation) && (REG_NONE == instruction->rs[0]);
 }
 
-static struct gadget_t *retFilter(uint16_t lastElement)
+// Room for capacity instructions, whatever the gadget ends up keeping
+static struct gadget_t *newGadget(struct ins32_t *terminator, uint16_t capacity)
 {
-    uint16_t current;
-    struct gadget_t *gadget = (gadget_t *)calloc(1, sizeof(struct gadget_t));
+    struct gadget_t *gadget = calloc(1, sizeof(struct gadget_t) + capacity * sizeof(ins32_t *));
 
-    gadget->instructions[0] = preliminary_gadget_list[lastElement];
-    gadget->length = 1;
-    current = 0 == lastElement ? 99 : lastElement - gadget->length;
-    while (gadget->length < MAX_LENGTH && checkValidity(preliminary_gadget_list[current]) &&
-           !isLastInstruction(preliminary_gadget_list[current]))
+    pushInstruction(gadget, terminator);
+    return gadget;
+}
+
+// Gadgets grow from the terminator backwards, each instruction runs before
+// the ones already there
+static void pushInstruction(struct gadget_t *gadget, struct ins32_t *instruction)
+{
+    gadget->instructions[gadget->length++] = instruction;
+    gadget->written |= REG_BIT(instruction->rd);
+
+    if (adjustsSp(instruction))
     {
-        gadget->instructions[gadget->length] = preliminary_gadget_list[current];
-        gadget->length++;
-        if (0 == current)
-        {
-            current = 99;
-        }
+        gadget->delta += instruction->immediate;
+    }
+}
 
-        else
-        {
-            current--;
-            if (0 == current)
-                current = 99;
-        }
+// Drops the instructions in front of length, the rest is pushed again
+static void cutGadget(struct gadget_t *gadget, uint16_t length)
+{
+    uint16_t i;
+
+    gadget->written = 0;
+    gadget->delta = 0;
+    gadget->length = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        pushInstruction(gadget, gadget->instructions[i]);
     }
+}
+
+static struct gadget_t *retFilter(size_t lastElement)
+{
+    ins32_t **instructions = region.instructions;
+    size_t current = lastElement;
+    struct gadget_t *gadget = newGadget(instructions[current], maxGadgetLength(RET));
 
-    if (isLastInstruction(preliminary_gadget_list[current]))
+    while (current && gadget->length < args.depth && checkValidity(instructions[current - 1]) &&
+           !isLastInstruction(instructions[current - 1]))
     {
-        gadget->instructions[gadget->length] = preliminary_gadget_list[current];
-        gadget->length++;
+        pushInstruction(gadget, instructions[--current]);
+    }
+
+    if (current && isLastInstruction(instructions[current - 1]))
+    {
+        pushInstruction(gadget, instructions[current - 1]);
         return gadget;
     }
     free(gadget);
@@ -113,14 +184,14 @@ static struct gadget_t *retFilter(uint16_t lastElement)
 
 static struct gadget_t *jopFilter(struct gadget_t *gadget)
 {
-    int8_t i;
-    char *refRegister;
+    int16_t i;
+    uint8_t target = gadget->instructions[0]->rs[0];
     uint8_t nCoindicendes = 0;
-    refRegister = gadget->instructions[0]->regDest;
 
-    for (i = gadget->length - 1; i >= 1; i--)
+    // Gadgets that keep rewriting the jump register are not worth it
+    for (i = gadget->length - 1; (i >= 1) && (gadget->written & REG_BIT(target)); i--)
     {
-        if (0 == strcmp(refRegister, gadget->instructions[i]->regDest))
+        if (target == gadget->instructions[i]->rd)
         {
             nCoindicendes++;
         }
@@ -134,145 +205,508 @@ static struct gadget_t *jopFilter(struct gadget_t *gadget)
     return gadget;
 }
 
-static struct gadget_t *noRetFilter(uint16_t lastElement)
+static struct gadget_t *noRetFilter(size_t lastElement, uint16_t maxLength)
+{
+    ins32_t **instructions = region.instructions;
+    size_t current = lastElement;
+    struct gadget_t *gadget = newGadget(instructions[current], maxLength);
+
+    while (current && gadget->length < maxLength && checkValidity(instructions[current - 1]))
+    {
+        pushInstruction(gadget, instructions[--current]);
+    }
+    return gadget;
+}
+
+// A dispatcher jumps to a value loaded through a register that is also
+// advanced by a constant, e.g. lw t0, 0(a0); addi a0, a0, 4; jr t0. start
+// is the index where the shortest one ending on the terminator begins
+static bool findDispatcher(struct gadget_t *gadget, uint16_t *start, uint8_t *base, int16_t *stride)
 {
-    uint16_t current;
-    struct gadget_t *gadget = (gadget_t *)calloc(1, sizeof(struct gadget_t));
+    uint8_t target = gadget->instructions[0]->rs[0];
+    int16_t i, load = -1, advance = -1;
+    struct ins32_t *instruction;
 
-    gadget->instructions[0] = preliminary_gadget_list[lastElement];
-    gadget->length = 1;
-    current = 0 == lastElement ? 99 : lastElement - gadget->length;
-    while (gadget->length < MAX_LENGTH_NO_RET &&
-           checkValidity(preliminary_gadget_list[current]))
+    if (!(gadget->written & REG_BIT(target)))
     {
-        gadget->instructions[gadget->length] = preliminary_gadget_list[current];
-        gadget->length++;
-        if (0 == current)
+        return false;
+    }
+
+    // Going backwards, the first write to the jump register must be the load
+    for (i = 1; i < gadget->length; i++)
+    {
+        instruction = gadget->instructions[i];
+
+        if (target == instruction->rd)
         {
-            current = 99;
+            if ((LOAD == instruction->operation) && (REG_NONE != instruction->rs[0]) &&
+                (target != instruction->rs[0]))
+            {
+                load = i;
+            }
+            break;
         }
+    }
 
-        else
+    if (load < 0)
+    {
+        return false;
+    }
+    *base = gadget->instructions[load]->rs[0];
+
+    // The base is written once between the start and the jump: the advance,
+    // either before or after the load
+    for (i = 1; i < gadget->length; i++)
+    {
+        instruction = gadget->instructions[i];
+
+        if ((i == load) || (*base != instruction->rd))
         {
-            current--;
-            if (0 == current)
-                current = 99;
+            continue;
         }
+
+        if ((advance >= 0) || (ADD != instruction->operation) || !instruction->useImmediate ||
+            (*base != instruction->rs[0]) || (0 == instruction->immediate))
+        {
+            // Written before the dispatcher starts, it doesn't matter
+            if ((advance >= 0) && (i > load))
+            {
+                break;
+            }
+            return false;
+        }
+        advance = i;
+
+        if (i > load)
+        {
+            break;
+        }
+    }
+
+    if (advance < 0)
+    {
+        return false;
+    }
+    *start = advance > load ? advance : load;
+    *stride = gadget->instructions[advance]->immediate;
+    return true;
+}
+
+static struct gadget_t *dispatcherFilter(struct gadget_t *gadget)
+{
+    uint16_t start;
+    uint8_t base;
+    int16_t stride;
+
+    if (NULL == gadget)
+    {
+        return NULL;
+    }
+
+    if (!findDispatcher(gadget, &start, &base, &stride))
+    {
+        free(gadget);
+        return NULL;
+    }
+
+    // Under CFI it has to start at the landing pad cfiFilter() left first
+    if (!(args.options & OPT_CFI))
+    {
+        cutGadget(gadget, start + 1);
     }
     return gadget;
 }
 
-void processGadgets(uint8_t lastElement, op_t lastOperation)
+// Whether the instruction moves sp somewhere the chain chose: another
+// register, memory, a constant or a big enough adjustment
+static bool describePivot(struct ins32_t *instruction, char *buf, size_t size)
+{
+    uint8_t rs1 = instruction->rs[0], rs2 = instruction->rs[1];
+    long value = instruction->immediate;
+    const char *text;
+
+    if (2 != instruction->rd) // sp
+    {
+        return false;
+    }
+    text = getDisassembled(instruction);
+
+    // li and lui are loads of their immediate
+    if ((LOAD == instruction->operation) && instruction->useImmediate)
+    {
+        snprintf(buf, size, "sp = %#x", (uint32_t)value);
+    }
+
+    else if ((LOAD == instruction->operation) && (rs1 < 32))
+    {
+        snprintf(buf, size, "sp = [%s %c %ld]", registerNames[rs1], value < 0 ? '-' : '+', labs(value));
+    }
+
+    else if ((rs1 < 32) && (2 != rs1) && (MOV == instruction->operation))
+    {
+        snprintf(buf, size, "sp = %s", registerNames[rs1]);
+    }
+
+    else if ((rs1 < 32) && (ADD == instruction->operation) && instruction->useImmediate)
+    {
+        // Small ones just release or allocate a frame
+        if ((2 == rs1) && (labs(value) < PIVOT_LIFT))
+        {
+            return false;
+        }
+        snprintf(buf, size, "sp = %s %c %ld", registerNames[rs1], value < 0 ? '-' : '+', labs(value));
+    }
+
+    else if ((rs1 < 32) && (rs2 < 32) &&
+             (0 == strncmp(text, "add\t", 4) || 0 == strncmp(text, "sub\t", 4)))
+    {
+        snprintf(buf, size, "sp = %s %c %s", registerNames[rs1], 'a' == text[0] ? '+' : '-',
+                 registerNames[rs2]);
+    }
+
+    // Anything else has to bring in a register other than sp
+    else if (((REG_NONE != rs1) && (0 != rs1) && (2 != rs1)) || ((REG_NONE != rs2) && (0 != rs2) && (2 != rs2)))
+    {
+        snprintf(buf, size, "%s", getPrettified(instruction));
+    }
+
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Index of the pivot closest to the terminator, -1 if there is none
+static int16_t findPivot(struct gadget_t *gadget)
+{
+    char buf[MAX_PIVOT];
+    int16_t i;
+
+    if (!(gadget->written & REG_BIT(2))) // sp
+    {
+        return -1;
+    }
+
+    for (i = 1; i < gadget->length; i++)
+    {
+        if (describePivot(gadget->instructions[i], buf, sizeof(buf)))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Keeps the gadgets that pivot, cut down to the last pivot. With CFI they
+// have to keep starting at the landing pad
+static struct gadget_t *pivotFilter(struct gadget_t *gadget)
+{
+    int16_t pivot;
+
+    if (NULL == gadget)
+    {
+        return NULL;
+    }
+    pivot = findPivot(gadget);
+
+    if (pivot < 0)
+    {
+        free(gadget);
+        return NULL;
+    }
+
+    if (!(args.options & OPT_CFI))
+    {
+        cutGadget(gadget, pivot + 1);
+    }
+    return gadget;
+}
+
+static void printPivot(struct gadget_t *gadget)
+{
+    char description[MAX_PIVOT];
+    int16_t pivot = findPivot(gadget);
+
+    if (pivot >= 0)
+    {
+        describePivot(gadget->instructions[pivot], description, sizeof(description));
+        printf(" [pivot: %s]", description);
+    }
+}
+
+// Constant propagation over li, lui, addi and mv up to the ecall. Registers
+// the gadget doesn't set, or loads from memory, hold what the chain put there
+static value_t syscallNumber(struct gadget_t *gadget, int32_t *number)
+{
+    value_t state[32];
+    int32_t value[32] = {0};
+    struct ins32_t *instruction;
+    uint8_t rd, rs;
+    int16_t i;
+
+    for (rd = 0; rd < 32; rd++)
+    {
+        state[rd] = VALUE_CONTROLLED;
+    }
+    state[0] = VALUE_CONSTANT;
+
+    for (i = gadget->length - 1; i >= 1; i--)
+    {
+        instruction = gadget->instructions[i];
+        rd = instruction->rd;
+        rs = instruction->rs[0];
+
+        // Floating point and vector registers don't matter here
+        if ((REG_NONE == rd) || (0 == rd) || (rd >= 32))
+        {
+            continue;
+        }
+
+        // li and lui are loads of their immediate
+        if ((LOAD == instruction->operation) && instruction->useImmediate)
+        {
+            state[rd] = VALUE_CONSTANT;
+            value[rd] = instruction->immediate;
+        }
+
+        else if ((rs < 32) && ((MOV == instruction->operation) ||
+                               ((ADD == instruction->operation) && instruction->useImmediate)))
+        {
+            state[rd] = state[rs];
+            value[rd] = value[rs] + (ADD == instruction->operation ? instruction->immediate : 0);
+        }
+
+        else
+        {
+            state[rd] = (LOAD == instruction->operation) ? VALUE_CONTROLLED : VALUE_UNKNOWN;
+        }
+    }
+    *number = value[17]; // a7
+    return state[17];
+}
+
+// With --syscall N, keeps the ecall gadgets that can make syscall N
+static struct gadget_t *syscallFilter(struct gadget_t *gadget)
+{
+    int32_t number;
+    value_t state;
+
+    if ((NULL == gadget) || (args.syscall < 0) || (SYSCALL != gadget->instructions[0]->operation))
+    {
+        return gadget;
+    }
+    state = syscallNumber(gadget, &number);
+
+    if ((VALUE_CONTROLLED == state) || ((VALUE_CONSTANT == state) && (args.syscall == number)))
+    {
+        return gadget;
+    }
+    free(gadget);
+    return NULL;
+}
+
+// Shortest dispatchers first, they clobber the least. Then by address
+int rankDispatchers(const void *a, const void *b)
+{
+    const struct trie_t *first = *(struct trie_t *const *)a, *second = *(struct trie_t *const *)b;
+
+    if (first->depth != second->depth)
+    {
+        return first->depth < second->depth ? -1 : 1;
+    }
+
+    if (first->instruction->address != second->instruction->address)
+    {
+        return first->instruction->address < second->instruction->address ? -1 : 1;
+    }
+    return 0;
+}
+
+// Keeps only the gadgets still reachable under Zicfilp/Zicfiss and tags them
+static struct gadget_t *cfiFilter(struct gadget_t *gadget, op_t lastOperation)
+{
+    int16_t i;
+
+    if (NULL == gadget)
+    {
+        return NULL;
+    }
+
+    if (RET == lastOperation)
+    {
+        // A return checked against the shadow stack can't be hijacked
+        for (i = gadget->length - 1; i >= 1; i--)
+        {
+            if (SSPOPCHK == gadget->instructions[i]->operation)
+            {
+                free(gadget);
+                return NULL;
+            }
+        }
+        gadget->cfi = CFI_UNCHECKED_RET;
+        return gadget;
+    }
+
+    // Indirect jumps must land on a lpad, so the gadget has to start at the
+    // furthest one available
+    for (i = gadget->length - 1; i >= 1; i--)
+    {
+        if (LPAD == gadget->instructions[i]->operation)
+        {
+            cutGadget(gadget, i + 1);
+            gadget->cfi = CFI_LANDING_PAD;
+            return gadget;
+        }
+    }
+
+    // Without a lpad only an unchecked return can reach a syscall gadget
+    if ((SYSCALL == lastOperation) || (ERET == lastOperation))
+    {
+        gadget->cfi = CFI_RET_ENTRY;
+        return gadget;
+    }
+    free(gadget);
+    return NULL;
+}
+
+static const char *cfiStatusName(cfi_status_t status)
+{
+    switch (status)
+    {
+    case CFI_LANDING_PAD:
+        return "landing-pad";
+    case CFI_UNCHECKED_RET:
+        return "unchecked-ret";
+    case CFI_RET_ENTRY:
+        return "ret-entry";
+    default:
+        return "none";
+    }
+}
+
+step_t walkStep(struct ins32_t *instruction)
+{
+    if (isLastInstruction(instruction))
+    {
+        return STEP_START;
+    }
+    return checkValidity(instruction) ? STEP_CONTINUE : STEP_STOP;
+}
+
+uint16_t maxGadgetLength(op_t lastOperation)
 {
-    char *key, *tmp, *newKey;
-    uint8_t index;
-    struct node_t *found;
+    // RET gadgets also look at the instruction right before the last one
+    return RET == lastOperation ? args.depth + 1 : args.jopDepth;
+}
+
+void processGadgets(size_t lastElement, op_t lastOperation)
+{
+    uint16_t index;
+    struct trie_t *node, *found;
     struct gadget_t *gadget;
 
     switch (lastOperation)
     {
     case RET:
-        gadget = retFilter(lastElement);
+        // A pivot doesn't need the lw ra, the chain goes on from the new stack
+        gadget = (PIVOT_MODE == args.mode) ? noRetFilter(lastElement, maxGadgetLength(RET))
+                                           : retFilter(lastElement);
         break;
     case SYSCALL:
-        gadget = noRetFilter(lastElement);
+    case ERET:
+    case CALL:
+        gadget = noRetFilter(lastElement, maxGadgetLength(lastOperation));
         break;
     case JMP:
-        gadget = noRetFilter(lastElement);
-        gadget = jopFilter(gadget);
+        gadget = noRetFilter(lastElement, maxGadgetLength(lastOperation));
+
+        // Dispatchers are mostly loads into the jump register and pivots
+        // don't care about it, jopFilter() would throw them away
+        if ((DISPATCHER_MODE != args.mode) && (PIVOT_MODE != args.mode))
+        {
+            gadget = jopFilter(gadget);
+        }
         break;
     default:
         break;
     }
 
-    if ((NULL != gadget) || (NULL != gadget && gadget->length > 0))
+    if (args.options & OPT_CFI)
+    {
+        gadget = cfiFilter(gadget, lastOperation);
+    }
+
+    if (DISPATCHER_MODE == args.mode)
+    {
+        gadget = dispatcherFilter(gadget);
+    }
+
+    if (PIVOT_MODE == args.mode)
     {
-        key = generateKey(gadget);
+        gadget = pivotFilter(gadget);
+    }
+    gadget = syscallFilter(gadget);
 
+    if ((NULL != gadget) || (NULL != gadget && gadget->length > 0))
+    {
         if (NULL == last)
         {
-            last = list;
+            last = trie;
         }
 
         for (index = 0; index < gadget->length; index++)
         {
-            if ((ADD == gadget->instructions[index]->operation) &&
-                (gadget->instructions[index]->useImmediate) &&
-                (0 == strcmp(gadget->instructions[index]->regDest, "sp")))
+            if (adjustsSp(gadget->instructions[index]))
             {
                 break;
             }
         }
 
-        if ((gadget->length >= 2) && (index < gadget->length))
-        {
+        // The trie only keeps the instructions, the gadget itself is done
+        node = findPath(trie, gadget);
 
-            if (NULL == lastSp)
-            {
-                lastSp = spDuplicated;
-            }
-
-            newKey = updateKey(key);
-            found = find(spDuplicated, newKey);
+        // Gadgets that only differ in how much they move sp are listed once,
+        // the one moving it the least wins
+        if (!node->isGadget && (gadget->length >= 2) && (index < gadget->length))
+        {
+            found = findVariant(trie, gadget, 0);
 
             if (NULL == found)
             {
-                lastSp = insert(lastSp, gadget, newKey);
-                last = insert(last, gadget, key);
+                last = markGadget(last, node, gadget);
             }
 
-            else
+            else if (found->delta > gadget->delta)
             {
-                if (found->data->instructions[index]->immediate > gadget->instructions[index]->immediate)
-                {
-                    tmp = generateKey(found->data);
-                    update(found, gadget, newKey);
-                    delete (list, tmp);
-                    free(tmp);
-                    tmp = NULL;
-                }
+                found->isGadget = false;
+                last = markGadget(last, node, gadget);
             }
-            free(key);
-            free(newKey);
-            key = NULL;
-            newKey = NULL;
         }
-        else
+
+        else if (!node->isGadget)
         {
-            if (NULL == find(list, key))
-            {
-                last = insert(last, gadget, key);
-            }
+            last = markGadget(last, node, gadget);
         }
+        free(gadget);
     }
 }
 
-// Generates a key where all the instructions have no separation
-static char *generateKey(struct gadget_t *gadget)
+// Prettifies the instruction the first time it's needed. The result is kept
+// in the instruction and shared by every comparison and every print
+const char *getPrettified(struct ins32_t *instruction)
 {
-    int8_t i;
-    size_t length;
-    char *prettified;
-    uint8_t index = 0;
-    char *buf = (char *)calloc(700, sizeof(char));
+    const char *src = getDisassembled(instruction);
+    char last = 0x0, *res;
+    size_t i = 0;
 
-    for (i = gadget->length - 1; i >= 0; i--)
+    if (instruction->prettified)
     {
-        prettified = prettifyString(gadget->instructions[i]->disassembled);
-        length = strlen(prettified);
-        strncpy(&buf[index], prettified, length);
-        index += length;
-        free(prettified);
+        return instruction->prettified;
     }
-    return buf;
-}
 
-// Prettifies the string before gets printed
-static char *prettifyString(char *src)
-{
-    char last, *res, buf[50];
-    uint8_t length;
-    uint8_t i = 0;
+    // Worst case: a space is added after every character (all commas)
+    res = (char *)malloc(2 * strlen(src) + 1);
 
     while (*src)
     {
@@ -285,16 +719,14 @@ static char *prettifyString(char *src)
 
         if (',' == last)
         {
-            buf[i++] = 0x20; // Space
+            res[i++] = 0x20; // Space
         }
-        buf[i++] = 0x9 == *src ? ' ' : *src; // Tab
+        res[i++] = 0x9 == *src ? ' ' : *src; // Tab
         last = *src;
         src++;
     }
-    buf[i] = 0x0;
-    length = strlen(buf) + 1;
-    res = (char *)calloc(length, sizeof(char));
-    strncpy(res, buf, length);
+    res[i] = 0x0;
+    instruction->prettified = res;
     return res;
 }
 
@@ -302,12 +734,15 @@ void printGadget(struct gadget_t *gadget)
 {
     if (gadget->length > 0)
     {
-        char *prettified;
-        int8_t i;
+        const char *prettified;
+        addr32_t label;
+        uint16_t start;
+        uint8_t base;
+        int16_t stride, i;
 
         for (i = gadget->length - 1; i >= 0; i--)
         {
-            prettified = prettifyString(gadget->instructions[i]->disassembled);
+            prettified = getPrettified(gadget->instructions[i]);
             if (gadget->length - 1 == i)
             {
                 printf("%#010x:%c", gadget->instructions[i]->address, 0x20);
@@ -322,26 +757,211 @@ void printGadget(struct gadget_t *gadget)
             {
                 printf("%s;%c", prettified, 0x20);
             }
-            free(prettified);
-            prettified = NULL;
+        }
+
+        printVectorLength(gadget);
+        printConditions(gadget);
+
+        if (SYSCALL == gadget->instructions[0]->operation)
+        {
+            printSyscall(gadget);
+        }
+
+        if (PIVOT_MODE == args.mode)
+        {
+            printPivot(gadget);
+        }
+
+        // A jalr overwrites its link register, ra unless another one is given
+        if (CALL == gadget->instructions[0]->operation)
+        {
+            printf(" [%s clobbered]", gadget->instructions[0]->regDest);
+        }
+
+        if ((DISPATCHER_MODE == args.mode) && findDispatcher(gadget, &start, &base, &stride))
+        {
+            printf(" [dispatcher: %s %s %d]", registerNames[base], stride < 0 ? "-=" : "+=",
+                   stride < 0 ? -stride : stride);
+        }
+
+        if (args.options & OPT_FRAME)
+        {
+            printFrame(gadget);
+        }
+
+        if (args.options & OPT_CFI)
+        {
+            printf(" [cfi: %s]", cfiStatusName(gadget->cfi));
+        }
+
+        if ((args.options & OPT_CROSS) && crossedLabel(gadget, &label))
+        {
+            printf(" [crosses: %#010x]", label);
+        }
+
+        if (NULL != gadget->transfer)
+        {
+            printTransfer(gadget->transfer);
         }
         putchar(0x0a); // Newline
     }
 }
 
-// Generates a key where the number X (addi sp, sp, X) is gone
-static char *updateKey(char *key)
+// Notes which vl/vtype the first vector memory access of the gadget runs with
+static void printVectorLength(struct gadget_t *gadget)
 {
-    size_t index = strlen(key);
-    char *aux = strdup(key);
-    char *last = &aux[index - 1];
+    int16_t i;
+    const char *config = NULL;
 
-    while (*last != 0x20)
+    for (i = gadget->length - 1; i >= 0; i--)
     {
-        last--;
+        if (VSETVL == gadget->instructions[i]->operation)
+        {
+            // Everything after rd: the AVL and the vtype
+            config = strstr(getDisassembled(gadget->instructions[i]), ",");
+        }
+
+        else if ((VLOAD == gadget->instructions[i]->operation) ||
+                 (VSTORE == gadget->instructions[i]->operation))
+        {
+            printf(" [vl: %s]", config ? config + 1 : "inherited");
+            return;
+        }
     }
+}
 
-    memset(last, 0x0, strlen(last));
-    memcpy(last, "ret", 3);
-    return aux;
+static void printSyscall(struct gadget_t *gadget)
+{
+    int32_t number;
+
+    switch (syscallNumber(gadget, &number))
+    {
+    case VALUE_CONSTANT:
+        printf(" [syscall: %d]", number);
+        break;
+    case VALUE_CONTROLLED:
+        printf(" [syscall: controllable]");
+        break;
+    default:
+        printf(" [syscall: unknown]");
+        break;
+    }
+}
+
+// Replays the gadget in the order it runs. Loads through sp count as
+// frame slots until sp is set some other way
+static void describeFrame(struct gadget_t *gadget, struct frame_t *frame)
+{
+    struct ins32_t *instruction;
+    uint8_t rd;
+    int16_t i;
+
+    memset(frame, 0x0, sizeof(struct frame_t));
+
+    for (i = gadget->length - 1; i >= 0; i--)
+    {
+        instruction = gadget->instructions[i];
+        rd = instruction->rd;
+
+        if (adjustsSp(instruction))
+        {
+            frame->delta += instruction->immediate;
+        }
+
+        else if (2 == rd) // sp
+        {
+            frame->moved = true;
+        }
+
+        else if ((LOAD == instruction->operation) && (2 == instruction->rs[0]) && !frame->moved && REG_BIT(rd))
+        {
+            frame->loaded |= REG_BIT(rd);
+            frame->slots[rd] = frame->delta + instruction->immediate;
+        }
+
+        // Anything else writing it overwrites what it was loaded with
+        else
+        {
+            frame->loaded &= ~REG_BIT(rd);
+        }
+    }
+}
+
+// What the chain has to lay out on the stack, e.g. [frame: sp += 16; ra @ 12]
+static void printFrame(struct gadget_t *gadget)
+{
+    struct frame_t frame;
+    uint8_t reg;
+
+    describeFrame(gadget, &frame);
+
+    if (frame.moved)
+    {
+        printf(" [frame: sp moved");
+    }
+
+    else
+    {
+        printf(" [frame: sp %s %d", frame.delta < 0 ? "-=" : "+=", frame.delta < 0 ? -frame.delta : frame.delta);
+    }
+
+    for (reg = 1; reg < 32; reg++)
+    {
+        if (frame.loaded & REG_BIT(reg))
+        {
+            printf("; %s @ %d", registerNames[reg], frame.slots[reg]);
+        }
+    }
+    putchar(']');
+}
+
+// What the branches of the gadget need to go the way it does
+static void printConditions(struct gadget_t *gadget)
+{
+    bool first = true;
+    int16_t i;
+
+    for (i = gadget->length - 1; i >= 0; i--)
+    {
+        if (gadget->instructions[i]->condition)
+        {
+            printf("%s%s", first ? " [if: " : " && ", gadget->instructions[i]->condition);
+            first = false;
+        }
+    }
+
+    if (!first)
+    {
+        putchar(']');
+    }
+}
+
+// First function the gadget falls through into, if it starts in another one
+static bool crossedLabel(struct gadget_t *gadget, addr32_t *label)
+{
+    addr32_t start = gadget->instructions[gadget->length - 1]->address;
+    size_t low = 0, high = labels.count, middle;
+
+    // First label after the start of the gadget
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (labels.addresses[middle] <= start)
+        {
+            low = middle + 1;
+        }
+
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < labels.count && labels.addresses[low] <= gadget->instructions[0]->address)
+    {
+        *label = labels.addresses[low];
+        return true;
+    }
+    return false;
 }
\ No newline at end of file
@@ -17,98 +17,183 @@
  */
 
 #include "node.h"
+#include "transfer.h"
 
-struct node_t *create()
+static void printNode(struct trie_t *root, struct trie_t *head, struct gadget_t *gadget);
+
+static __attribute__((always_inline)) inline bool sameCondition(struct ins32_t *first, struct ins32_t *second);
+
+// Branches taken and not taken share their text, not their condition
+static inline bool sameCondition(struct ins32_t *first, struct ins32_t *second)
 {
-    struct node_t *list = (node_t *)calloc(1, sizeof(struct node_t));
-    return list;
+    if (!first->condition || !second->condition)
+    {
+        return first->condition == second->condition;
+    }
+    return 0 == strcmp(first->condition, second->condition);
 }
 
-struct node_t *insert(struct node_t *list, struct gadget_t *data, const char *key)
+struct trie_t *createTrie()
 {
-    list->key = strdup(key);
-    list->data = data;
-    list->next = create();
-    return list->next;
+    struct trie_t *root = (trie_t *)calloc(1, sizeof(struct trie_t));
+    return root;
 }
 
-void update(struct node_t *node, struct gadget_t *data, const char *key)
+// Node where the gadget starts. The path is created as needed, sharing
+// every instruction already seen before the same tail
+struct trie_t *findPath(struct trie_t *root, struct gadget_t *gadget)
 {
-    node->key = key;
-    node->data = data;
+    struct trie_t *node = root, *child;
+    const char *text;
+    uint16_t i;
+
+    for (i = 0; i < gadget->length; i++)
+    {
+        text = getPrettified(gadget->instructions[i]);
+
+        for (child = node->children; NULL != child; child = child->sibling)
+        {
+            if ((child->instruction->prettified == text ||
+                 0 == strcmp(getPrettified(child->instruction), text)) &&
+                sameCondition(child->instruction, gadget->instructions[i]))
+            {
+                break;
+            }
+        }
+
+        if (NULL == child)
+        {
+            child = createTrie();
+            child->instruction = gadget->instructions[i];
+            child->parent = node;
+            child->depth = node->depth + 1;
+            child->sibling = node->children;
+            node->children = child;
+        }
+        node = child;
+    }
+    return node;
 }
 
-struct node_t *find(struct node_t *list, const char *key)
+// Gadget already listed that runs the same instructions from the i-th one
+// on, only moving sp by other amounts. Every addi sp, sp, X is a match, so
+// this may look down a few siblings, never through the whole trie
+struct trie_t *findVariant(struct trie_t *node, struct gadget_t *gadget, uint16_t i)
 {
-    if (NULL == list)
+    struct trie_t *child, *found;
+    struct ins32_t *instruction;
+    const char *text;
+
+    if (i == gadget->length)
     {
-        return NULL;
+        return node->isGadget ? node : NULL;
     }
+    instruction = gadget->instructions[i];
+    text = getPrettified(instruction);
 
-    struct node_t *head = list;
-    while (NULL != head->data)
+    for (child = node->children; NULL != child; child = child->sibling)
     {
-        if (0 == strcmp(head->key, key))
+        if (adjustsSp(instruction) && adjustsSp(child->instruction))
         {
-            return head;
+            if (NULL != (found = findVariant(child, gadget, i + 1)))
+            {
+                return found;
+            }
+        }
+
+        else if ((child->instruction->prettified == text || 0 == strcmp(getPrettified(child->instruction), text)) &&
+                 sameCondition(child->instruction, instruction))
+        {
+            return findVariant(child, gadget, i + 1);
         }
-        head = head->next;
     }
     return NULL;
 }
 
-void printContent(struct node_t *list)
+// Makes the node a gadget of its own, listed after last. The gadget keeps
+// its first and last instructions so it's printed with its own addresses
+struct trie_t *markGadget(struct trie_t *last, struct trie_t *node, struct gadget_t *gadget)
 {
-    if (NULL == list)
-    {
-        return;
-    }
-    struct node_t *head = list;
-    while (NULL != head->data)
+    node->instruction = gadget->instructions[gadget->length - 1];
+    node->terminator = gadget->instructions[0];
+    node->cfi = gadget->cfi;
+    node->delta = gadget->delta;
+    node->isGadget = true;
+    last->nextGadget = node;
+    return node;
+}
+
+// Lays the path of a marked node out as a gadget and prints it
+static void printNode(struct trie_t *root, struct trie_t *head, struct gadget_t *gadget)
+{
+    struct trie_t *node;
+
+    gadget->length = head->depth;
+    gadget->cfi = head->cfi;
+    gadget->written = 0;
+    gadget->delta = head->delta;
+    gadget->transfer = (args.options & OPT_TRANSFER) ? transferOf(root, head) : NULL;
+
+    for (node = head; node != root; node = node->parent)
     {
-        printGadget(head->data);
-        head = head->next;
+        gadget->instructions[node->depth - 1] = node->instruction;
+        gadget->written |= REG_BIT(node->instruction->rd);
     }
+    gadget->instructions[0] = head->terminator;
+    printGadget(gadget);
 }
 
-struct gadget_t *delete(struct node_t *list, const char *key)
+// Prints the gadgets in the order they were found, or sorted by rank if given
+void printContent(struct trie_t *root, int (*rank)(const void *, const void *))
 {
-    if (NULL == list)
+    struct gadget_t *gadget;
+    struct trie_t *head, **sorted = NULL;
+    size_t count = 0, i;
+
+    if (NULL == root)
     {
-        return NULL;
+        return;
     }
+    gadget = (gadget_t *)malloc(sizeof(struct gadget_t) + (MAX_DEPTH + 1) * sizeof(ins32_t *));
 
-    struct gadget_t *res;
-    struct node_t *head = list, *last = NULL;
-    while ((NULL != head->data) && (0 != strcmp(head->key, key)))
+    if (NULL == gadget)
     {
-        last = head;
-        head = head->next;
+        fprintf(stderr, "[-] Not enough memory for printing the gadgets\n");
+        return;
     }
 
-    if (NULL == last)
+    for (head = root->nextGadget; NULL != head; head = head->nextGadget)
     {
-        res = head->data;
-        list = list->next;
-        free(head);
-        head = NULL;
-        return res;
+        count += head->isGadget;
     }
 
-    if ((NULL == head->data) && (0 == strcmp(last->key, key)))
+    if (rank && (sorted = (trie_t **)malloc(count * sizeof(trie_t *))))
     {
-        free(head);
-        head = NULL;
-        return last->data;
+        for (i = 0, head = root->nextGadget; NULL != head; head = head->nextGadget)
+        {
+            if (head->isGadget)
+            {
+                sorted[i++] = head;
+            }
+        }
+        qsort(sorted, count, sizeof(trie_t *), rank);
+
+        for (i = 0; i < count; i++)
+        {
+            printNode(root, sorted[i], gadget);
+        }
     }
-    else if (NULL == head->data)
+
+    else
     {
-        return NULL;
+        for (head = root->nextGadget; NULL != head; head = head->nextGadget)
+        {
+            if (head->isGadget)
+            {
+                printNode(root, head, gadget);
+            }
+        }
     }
-
-    res = head->data;
-    last->next = head->next;
-    free(head);
-    head = NULL;
-    return res;
+    free(sorted);
+    free(gadget);
 }
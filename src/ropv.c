@@ -22,12 +22,27 @@
 
 #include "datatypes.h"
 #include "disas.h"
+#include "gadget.h"
 
 static struct argp_option options[] = {
     {"all", 'a', 0, 0, "Show all gadgets. Option selected by default", 0},
     {"ret", 'r', 0, 0, "Show only RET gadgets", 1},
     {"jop", 'j', 0, 0, "Show only JOP gadgets", 2},
     {"sys", 's', 0, 0, "Show only SYSCALL gadgets", 3},
+    {"dispatchers", 'D', 0, 0, "Show only JOP dispatcher gadgets, shortest first", 3},
+    {"cop", 'C', 0, 0, "Show only COP gadgets, the ones ending in a call through a register (jalr)", 3},
+    {"pivots", 'P', 0, 0, "Show only stack pivot gadgets, the ones moving sp to a register, memory or far away, and tag the pivot", 3},
+    {"syscall", 'N', "N", 0, "Show only SYSCALL gadgets able to make syscall N: a7 is set to N or controllable", 3},
+    {"cfi", 'c', 0, 0, "Keep only gadgets usable under Zicfilp/Zicfiss and tag their CFI status", 4},
+    {"kernel", 'k', 0, 0, "Kernel/firmware scan: sret/mret end gadgets and privileged instructions are allowed", 5},
+    {"objdump", 'o', 0, 0, "Disassemble with the external objdump instead of the built-in decoder", 6},
+    {"scan", 'S', "STRATEGY", 0, "Both decode only behind terminators. linear (default) keeps to the instruction boundaries objdump shows, backward tries every halfword and also finds misaligned gadgets", 7},
+    {"depth", 'd', "N", 0, "Instructions a RET gadget can have, ret included and lw ra not (default 30, up to 255)", 8},
+    {"jop-depth", 'J', "N", 0, "Instructions a JOP/SYSCALL gadget can have, terminator included (default 6, up to 255)", 9},
+    {"cross", 'x', 0, 0, "Keep scanning past terminators and function boundaries, code can fall through into the next function. Gadgets that do are tagged", 10},
+    {"branches", 'b', 0, 0, "Follow conditional branches both ways and tag each gadget with the conditions its path needs. Backward scan only", 11},
+    {"frame", 'F', 0, 0, "Tag each gadget with how far it moves sp and the stack offsets, from sp at its start, of the registers it loads", 12},
+    {"transfer", 'T', 0, 0, "Tag each gadget with what it leaves in the registers it writes and in pc, in terms of the registers it starts with", 13},
     {0}};
 
 struct arguments args;
@@ -41,9 +56,23 @@ const char *argp_program_bug_address = "comes.josep2@gmail.com";
 static char doc[] = "Tool for ROP explotation (ELF binaries & RISC-V architecture)";
 static char args_doc[] = "file";
 
+static uint8_t parseDepth(struct argp_state *state, const char *arg, const char *option)
+{
+    char *endptr;
+    unsigned long depth = strtoul(arg, &endptr, 10);
+
+    if (!*arg || *endptr || depth < 1 || depth > MAX_DEPTH)
+    {
+        argp_failure(state, 1, 0, "Invalid %s %s. It must be between 1 and %d", option, arg, MAX_DEPTH);
+    }
+    return (uint8_t)depth;
+}
+
 static error_t parse_opt(int key, char *arg, struct argp_state *state)
 {
     struct arguments *arguments = state->input;
+    char *endptr;
+    long number;
 
     switch (key)
     {
@@ -55,7 +84,7 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         }
         else
         {
-            argp_failure(state, 1, 1, "Invalid argument combination. Options -a and [-r -j -s] are mutually exclusive");
+            argp_failure(state, 1, 1, "Invalid argument combination. Options -a and [-r -j -s -D -C -N -P] are mutually exclusive");
         }
         break;
 
@@ -95,6 +124,113 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         }
         break;
 
+    case 'P':
+        if (!genericModeSelected)
+        {
+            arguments->mode = PIVOT_MODE;
+            otherModeSelected = true;
+        }
+        else
+        {
+            argp_failure(state, 1, 1, "Invalid argument combination. Options -P and -a are mutually exclusive");
+        }
+        break;
+
+    case 'D':
+        if (!genericModeSelected)
+        {
+            arguments->mode = DISPATCHER_MODE;
+            otherModeSelected = true;
+        }
+        else
+        {
+            argp_failure(state, 1, 1, "Invalid argument combination. Options -D and -a are mutually exclusive");
+        }
+        break;
+
+    case 'C':
+        if (!genericModeSelected)
+        {
+            arguments->mode = COP_MODE;
+            otherModeSelected = true;
+        }
+        else
+        {
+            argp_failure(state, 1, 1, "Invalid argument combination. Options -C and -a are mutually exclusive");
+        }
+        break;
+
+    case 'N':
+        number = strtol(arg, &endptr, 0);
+
+        if (!*arg || *endptr || number < 0 || number > INT32_MAX)
+        {
+            argp_failure(state, 1, 0, "Invalid syscall number %s", arg);
+        }
+
+        else if (!genericModeSelected)
+        {
+            arguments->mode = SYSCALL_MODE;
+            arguments->syscall = number;
+            otherModeSelected = true;
+        }
+        else
+        {
+            argp_failure(state, 1, 1, "Invalid argument combination. Options -N and -a are mutually exclusive");
+        }
+        break;
+
+    case 'c':
+        arguments->options |= OPT_CFI;
+        break;
+
+    case 'k':
+        arguments->options |= OPT_KERNEL;
+        break;
+
+    case 'o':
+        arguments->options |= OPT_OBJDUMP;
+        break;
+
+    case 'x':
+        arguments->options |= OPT_CROSS;
+        break;
+
+    case 'b':
+        arguments->options |= OPT_BRANCH;
+        break;
+
+    case 'F':
+        arguments->options |= OPT_FRAME;
+        break;
+
+    case 'T':
+        arguments->options |= OPT_TRANSFER;
+        break;
+
+    case 'S':
+        if (!strcmp(arg, "linear"))
+        {
+            arguments->scan = LINEAR_SCAN;
+        }
+        else if (!strcmp(arg, "backward"))
+        {
+            arguments->scan = BACKWARD_SCAN;
+        }
+        else
+        {
+            argp_failure(state, 1, 0, "Unknown scan strategy %s. Use linear or backward", arg);
+        }
+        break;
+
+    case 'd':
+        arguments->depth = parseDepth(state, arg, "depth");
+        break;
+
+    case 'J':
+        arguments->jopDepth = parseDepth(state, arg, "JOP depth");
+        break;
+
     case ARGP_KEY_ARG:
         if (state->arg_num >= 1)
         {
@@ -111,6 +247,16 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         {
             argp_usage(state);
         }
+
+        else if ((arguments->options & OPT_OBJDUMP) && BACKWARD_SCAN == arguments->scan)
+        {
+            argp_failure(state, 1, 0, "Invalid argument combination. Option -o only supports the linear scan");
+        }
+
+        else if ((arguments->options & OPT_BRANCH) && BACKWARD_SCAN != arguments->scan)
+        {
+            argp_failure(state, 1, 0, "Invalid argument combination. Option -b needs the backward scan (-S backward)");
+        }
         break;
 
     default:
@@ -125,6 +271,9 @@ int main(int argc, char *argv[])
 {
     memset(&args, 0x0, sizeof(struct arguments));
     args.mode = GENERIC_MODE;
+    args.depth = DEFAULT_DEPTH;
+    args.jopDepth = DEFAULT_JOP_DEPTH;
+    args.syscall = -1;
     argp_parse(&argp, argc, argv, 0, 0, &args);
     return disassemble(args.file);
 }
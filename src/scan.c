@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "scan.h"
+
+// jalr with funct3 = 0, whatever rd/rs1/imm are
+#define JALR_MASK 0x707f
+#define JALR_MATCH 0x67
+#define ECALL 0x73
+#define SRET 0x10200073
+#define MRET 0x30200073
+// c.jr and c.jalr: 100x rs1 00000 10 with rs1 != 0
+#define CJR_MASK 0xe07f
+#define CJR_MATCH 0x8002
+#define CJR_RS1 0x0f80
+// b* with funct3 = 2 or 3 is not a branch
+#define BRANCH_MASK 0x7f
+#define BRANCH_MATCH 0x63
+// c.beqz and c.bnez: 11x ... 01
+#define CBRANCH_MASK 0xc003
+#define CBRANCH_MATCH 0xc001
+
+typedef struct candidates_t
+{
+    uint32_t *offsets;
+    size_t count;
+    size_t capacity;
+} candidates_t;
+
+static bool addCandidate(struct candidates_t *found, uint32_t offset);
+
+static bool addMask(struct candidates_t *found, uint32_t base, uint32_t mask);
+
+static size_t scanScalar(const uint8_t *code, size_t start, size_t size, struct candidates_t *found);
+
+#if defined(__x86_64__) || defined(__i386__)
+static size_t scanSse2(const uint8_t *code, size_t size, struct candidates_t *found);
+
+static size_t scanAvx2(const uint8_t *code, size_t size, struct candidates_t *found);
+#endif
+
+static int compareBranches(const void *a, const void *b);
+
+static __attribute__((always_inline)) inline bool isTerminator(const uint8_t *code, size_t offset, size_t size);
+
+static inline bool isTerminator(const uint8_t *code, size_t offset, size_t size)
+{
+    uint16_t half = code[offset] | (code[offset + 1] << 8);
+    uint32_t word;
+
+    if ((CJR_MATCH == (half & CJR_MASK)) && (half & CJR_RS1))
+    {
+        return true;
+    }
+
+    if (offset + 4 > size)
+    {
+        return false;
+    }
+    word = half | (code[offset + 2] << 16) | ((uint32_t)code[offset + 3] << 24);
+    return (JALR_MATCH == (word & JALR_MASK)) || (ECALL == word) || (SRET == word) || (MRET == word);
+}
+
+static bool addCandidate(struct candidates_t *found, uint32_t offset)
+{
+    uint32_t *tmp;
+
+    if (found->count == found->capacity)
+    {
+        found->capacity = found->capacity ? 2 * found->capacity : 256;
+        tmp = (uint32_t *)realloc(found->offsets, found->capacity * sizeof(uint32_t));
+        if (!tmp)
+        {
+            return false;
+        }
+        found->offsets = tmp;
+    }
+    found->offsets[found->count++] = offset;
+    return true;
+}
+
+// Bit i of mask set means there is a candidate at base + i
+static bool addMask(struct candidates_t *found, uint32_t base, uint32_t mask)
+{
+    while (mask)
+    {
+        if (!addCandidate(found, base + __builtin_ctz(mask)))
+        {
+            return false;
+        }
+        mask &= mask - 1;
+    }
+    return true;
+}
+
+static size_t scanScalar(const uint8_t *code, size_t start, size_t size, struct candidates_t *found)
+{
+    size_t offset;
+
+    for (offset = start; offset + 2 <= size; offset += 2)
+    {
+        if (isTerminator(code, offset, size) && !addCandidate(found, offset))
+        {
+            break;
+        }
+    }
+    return offset;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Each step checks the 8 halfwords of one vector and the 32-bit words starting
+// at all of them, using a second load shifted by a halfword for the odd ones.
+// Returns where the scalar loop has to carry on
+__attribute__((target("sse2"))) static size_t scanSse2(const uint8_t *code, size_t size, struct candidates_t *found)
+{
+    const __m128i jalrMask = _mm_set1_epi32(JALR_MASK), jalr = _mm_set1_epi32(JALR_MATCH);
+    const __m128i ecall = _mm_set1_epi32(ECALL), sret = _mm_set1_epi32(SRET), mret = _mm_set1_epi32(MRET);
+    const __m128i cjrMask = _mm_set1_epi16(CJR_MASK), cjr = _mm_set1_epi16(CJR_MATCH);
+    const __m128i cjrRs1 = _mm_set1_epi16(CJR_RS1), zero = _mm_setzero_si128();
+    __m128i even, odd, hit;
+    uint32_t mask, evenMask, oddMask;
+    size_t offset;
+
+    for (offset = 0; offset + 18 <= size; offset += 16)
+    {
+        even = _mm_loadu_si128((const __m128i *)&code[offset]);
+        odd = _mm_loadu_si128((const __m128i *)&code[offset + 2]);
+
+        hit = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(even, cjrRs1), zero),
+                               _mm_cmpeq_epi16(_mm_and_si128(even, cjrMask), cjr));
+        mask = _mm_movemask_epi8(hit) & 0x5555;
+
+        hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(even, jalrMask), jalr),
+                                        _mm_cmpeq_epi32(even, ecall)),
+                           _mm_or_si128(_mm_cmpeq_epi32(even, sret), _mm_cmpeq_epi32(even, mret)));
+        evenMask = _mm_movemask_epi8(hit) & 0x1111;
+
+        hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(odd, jalrMask), jalr),
+                                        _mm_cmpeq_epi32(odd, ecall)),
+                           _mm_or_si128(_mm_cmpeq_epi32(odd, sret), _mm_cmpeq_epi32(odd, mret)));
+        oddMask = _mm_movemask_epi8(hit) & 0x1111;
+
+        if (!addMask(found, offset, mask | evenMask | (oddMask << 2)))
+        {
+            break;
+        }
+    }
+    return offset;
+}
+
+// Same as scanSse2() with 16 halfwords per step
+__attribute__((target("avx2"))) static size_t scanAvx2(const uint8_t *code, size_t size, struct candidates_t *found)
+{
+    const __m256i jalrMask = _mm256_set1_epi32(JALR_MASK), jalr = _mm256_set1_epi32(JALR_MATCH);
+    const __m256i ecall = _mm256_set1_epi32(ECALL), sret = _mm256_set1_epi32(SRET);
+    const __m256i mret = _mm256_set1_epi32(MRET), cjrMask = _mm256_set1_epi16(CJR_MASK);
+    const __m256i cjr = _mm256_set1_epi16(CJR_MATCH), cjrRs1 = _mm256_set1_epi16(CJR_RS1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i even, odd, hit;
+    uint32_t mask, evenMask, oddMask;
+    size_t offset;
+
+    for (offset = 0; offset + 34 <= size; offset += 32)
+    {
+        even = _mm256_loadu_si256((const __m256i *)&code[offset]);
+        odd = _mm256_loadu_si256((const __m256i *)&code[offset + 2]);
+
+        hit = _mm256_andnot_si256(_mm256_cmpeq_epi16(_mm256_and_si256(even, cjrRs1), zero),
+                                  _mm256_cmpeq_epi16(_mm256_and_si256(even, cjrMask), cjr));
+        mask = _mm256_movemask_epi8(hit) & 0x55555555;
+
+        hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(even, jalrMask), jalr),
+                                              _mm256_cmpeq_epi32(even, ecall)),
+                              _mm256_or_si256(_mm256_cmpeq_epi32(even, sret), _mm256_cmpeq_epi32(even, mret)));
+        evenMask = _mm256_movemask_epi8(hit) & 0x11111111;
+
+        hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(odd, jalrMask), jalr),
+                                              _mm256_cmpeq_epi32(odd, ecall)),
+                              _mm256_or_si256(_mm256_cmpeq_epi32(odd, sret), _mm256_cmpeq_epi32(odd, mret)));
+        oddMask = _mm256_movemask_epi8(hit) & 0x11111111;
+
+        if (!addMask(found, offset, mask | evenMask | (oddMask << 2)))
+        {
+            break;
+        }
+    }
+    return offset;
+}
+#endif
+
+size_t findTerminators(const uint8_t *code, size_t size, uint32_t **candidates)
+{
+    struct candidates_t found = {NULL, 0, 0};
+    size_t offset = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        offset = scanAvx2(code, size, &found);
+    }
+
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        offset = scanSse2(code, size, &found);
+    }
+#endif
+
+    scanScalar(code, offset, size, &found);
+    *candidates = found.offsets;
+    return found.count;
+}
+
+bool decodeBranch(const uint8_t *code, size_t offset, size_t size, struct branch_t *branch)
+{
+    uint16_t half = code[offset] | (code[offset + 1] << 8);
+    uint32_t word;
+    int32_t immediate;
+
+    if (CBRANCH_MATCH == (half & CBRANCH_MASK))
+    {
+        immediate = ((half >> 4) & 0x100) | ((half << 1) & 0xc0) | ((half << 3) & 0x20) |
+                    ((half >> 7) & 0x18) | ((half >> 2) & 0x6);
+        branch->rs1 = 8 + ((half >> 7) & 0x7);
+        branch->rs2 = 0;
+        branch->funct3 = (half >> 13) & 0x1; // c.beqz is beq, c.bnez is bne
+        branch->target = offset + ((immediate ^ 0x100) - 0x100);
+        branch->source = offset;
+        return true;
+    }
+
+    if ((0x3 != (half & 0x3)) || (offset + 4 > size))
+    {
+        return false;
+    }
+    word = half | (code[offset + 2] << 16) | ((uint32_t)code[offset + 3] << 24);
+    branch->funct3 = (word >> 12) & 0x7;
+
+    if ((BRANCH_MATCH != (word & BRANCH_MASK)) || (2 == branch->funct3) || (3 == branch->funct3))
+    {
+        return false;
+    }
+    immediate = ((word >> 19) & 0x1000) | ((word << 4) & 0x800) | ((word >> 20) & 0x7e0) |
+                ((word >> 7) & 0x1e);
+    branch->rs1 = (word >> 15) & 0x1f;
+    branch->rs2 = (word >> 20) & 0x1f;
+    branch->target = offset + ((immediate ^ 0x1000) - 0x1000);
+    branch->source = offset;
+    return true;
+}
+
+static int compareBranches(const void *a, const void *b)
+{
+    const branch_t *first = (const branch_t *)a, *second = (const branch_t *)b;
+
+    if (first->target != second->target)
+    {
+        return first->target < second->target ? -1 : 1;
+    }
+    return first->source < second->source ? -1 : (first->source > second->source);
+}
+
+size_t findBranches(const uint8_t *code, size_t size, struct branch_t **branches)
+{
+    size_t offset, count = 0, capacity = 0;
+    struct branch_t branch, *tmp;
+
+    *branches = NULL;
+
+    for (offset = 0; offset + 2 <= size; offset += 2)
+    {
+        if (!decodeBranch(code, offset, size, &branch) || branch.target >= size)
+        {
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 256;
+            tmp = (branch_t *)realloc(*branches, capacity * sizeof(branch_t));
+            if (!tmp)
+            {
+                break;
+            }
+            *branches = tmp;
+        }
+        (*branches)[count++] = branch;
+    }
+    qsort(*branches, count, sizeof(branch_t), compareBranches);
+    return count;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2022 Josep Comes Sanchis
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+#include "transfer.h"
+
+static sym_t effectOf(struct ins32_t *instruction, uint8_t *written);
+
+static sym_t storeBefore(sym_t value, struct ins32_t *instruction);
+
+static sym_t shift(sym_t value, int32_t offset);
+
+static sym_t substitute(sym_t value, uint8_t reg, sym_t replacement);
+
+static void printOffset(int32_t offset);
+
+static void printValue(sym_t value);
+
+// What the instruction leaves in *written, in terms of the registers before
+// it. *written is REG_NONE when it doesn't write an integer register or pc
+static sym_t effectOf(struct ins32_t *instruction, uint8_t *written)
+{
+    uint8_t rs = instruction->rs[0];
+    int32_t value = instruction->immediate;
+    sym_t effect = {SYM_UNKNOWN, 0, 0, 0};
+
+    *written = (instruction->rd > 0 && instruction->rd < 32) ? instruction->rd : REG_NONE;
+
+    switch (instruction->operation)
+    {
+    // li and lui load their immediate, the rest read mem[rs + offset]
+    case LOAD:
+        if (instruction->useImmediate)
+        {
+            effect = (sym_t){SYM_CONST, 0, value, 0};
+        }
+
+        else if (rs < 32)
+        {
+            effect = (sym_t){SYM_MEM, rs, value, 0};
+        }
+        break;
+
+    case MOV:
+        if (rs < 32)
+        {
+            effect = (sym_t){SYM_REG, rs, 0, 0};
+        }
+        break;
+
+    // auipc has no register to add to
+    case ADD:
+        if (instruction->useImmediate && (rs < 32))
+        {
+            effect = (sym_t){SYM_REG, rs, value, 0};
+        }
+        break;
+
+    // The terminator leaves pc, a jalr also its link register
+    case RET:
+        *written = TRANSFER_PC;
+        effect = (sym_t){SYM_REG, 1, 0, 0}; // ra
+        break;
+
+    case CALL:
+    case JMP:
+        *written = (rs < 32) ? TRANSFER_PC : REG_NONE;
+        effect = (sym_t){SYM_REG, rs, value, 0};
+        break;
+
+    default:
+        break;
+    }
+
+    // x0 + offset is just the offset
+    if ((SYM_REG == effect.kind) && (0 == effect.reg))
+    {
+        effect.kind = SYM_CONST;
+    }
+    return effect;
+}
+
+// value with a write to memory before it. A load that may read what was
+// written is unknown. Only plain stores tell where they write: rs[1] + offset
+static sym_t storeBefore(sym_t value, struct ins32_t *instruction)
+{
+    int32_t distance = value.offset - instruction->immediate;
+    // Integer loads and stores take up to 4 bytes, fsd stores 8
+    int32_t width = instruction->rs[0] < 32 ? 4 : 8;
+
+    if (SYM_MEM != value.kind)
+    {
+        return value;
+    }
+
+    if ((STORE == instruction->operation) && (instruction->rs[1] == value.reg) && (distance >= width || distance <= -4))
+    {
+        return value;
+    }
+    return (sym_t){SYM_UNKNOWN, 0, 0, 0};
+}
+
+static sym_t shift(sym_t value, int32_t offset)
+{
+    switch (value.kind)
+    {
+    case SYM_CONST:
+    case SYM_REG:
+        value.offset += offset;
+        return value;
+
+    case SYM_MEM:
+        value.addend += offset;
+        return value;
+
+    default:
+        return 0 == offset ? value : (sym_t){SYM_UNKNOWN, 0, 0, 0};
+    }
+}
+
+// value with what reg held replaced by what an earlier instruction put there
+static sym_t substitute(sym_t value, uint8_t reg, sym_t replacement)
+{
+    if ((SYM_REG == value.kind) && (reg == value.reg))
+    {
+        return shift(replacement, value.offset);
+    }
+
+    if ((SYM_MEM == value.kind) && (reg == value.reg))
+    {
+        // The address has to stay reg + offset, or a plain constant
+        if ((SYM_REG == replacement.kind) || (SYM_CONST == replacement.kind))
+        {
+            return (sym_t){SYM_MEM, SYM_CONST == replacement.kind ? 0 : replacement.reg,
+                           replacement.offset + value.offset, value.addend};
+        }
+        return (sym_t){SYM_UNKNOWN, 0, 0, 0};
+    }
+    return value;
+}
+
+struct transfer_t *transferOf(struct trie_t *root, struct trie_t *node)
+{
+    struct transfer_t *transfer;
+    op_t operation = node->instruction->operation;
+    sym_t effect;
+    uint8_t written, reg;
+
+    if ((root == node) || (NULL != node->transfer))
+    {
+        return node->transfer;
+    }
+
+    // Children of the root are terminators, they start from an empty one
+    transfer = (transfer_t *)calloc(1, sizeof(struct transfer_t));
+    if (root != node->parent)
+    {
+        memcpy(transfer, transferOf(root, node->parent), sizeof(struct transfer_t));
+    }
+    effect = effectOf(node->instruction, &written);
+
+    if ((STORE == operation) || (VSTORE == operation) || (ATOMIC == operation) || (SSPUSH == operation))
+    {
+        for (reg = 1; reg <= TRANSFER_PC; reg++)
+        {
+            transfer->values[reg] = storeBefore(transfer->values[reg], node->instruction);
+        }
+    }
+
+    if (REG_NONE != written)
+    {
+        for (reg = 1; reg <= TRANSFER_PC; reg++)
+        {
+            if (transfer->written & (1ull << reg))
+            {
+                transfer->values[reg] = substitute(transfer->values[reg], written, effect);
+            }
+        }
+
+        // Later writes win, only the ones not overwritten are kept
+        if (!(transfer->written & (1ull << written)))
+        {
+            transfer->written |= 1ull << written;
+            transfer->values[written] = effect;
+        }
+    }
+
+    // A jalr also leaves its link register
+    if ((CALL == operation) && (node->instruction->rd > 0) && (node->instruction->rd < 32))
+    {
+        transfer->written |= 1ull << node->instruction->rd;
+        transfer->values[node->instruction->rd] = (sym_t){SYM_LINK, 0, 0, 0};
+    }
+    node->transfer = transfer;
+    return transfer;
+}
+
+static void printOffset(int32_t offset)
+{
+    if (offset)
+    {
+        printf(" %c %d", offset < 0 ? '-' : '+', offset < 0 ? -offset : offset);
+    }
+}
+
+static void printValue(sym_t value)
+{
+    switch (value.kind)
+    {
+    case SYM_CONST:
+        printf((value.offset > -4096 && value.offset < 4096) ? "%d" : "%#x", value.offset);
+        break;
+
+    case SYM_REG:
+        printf("%s", registerNames[value.reg]);
+        printOffset(value.offset);
+        break;
+
+    case SYM_MEM:
+        if (0 == value.reg)
+        {
+            printf("mem[%#x]", (uint32_t)value.offset);
+        }
+
+        else
+        {
+            printf("mem[%s", registerNames[value.reg]);
+            printOffset(value.offset);
+            putchar(']');
+        }
+        printOffset(value.addend);
+        break;
+
+    case SYM_LINK:
+        printf("link");
+        break;
+
+    default:
+        putchar('?');
+        break;
+    }
+}
+
+void printTransfer(const struct transfer_t *transfer)
+{
+    const char *separator = "";
+    uint8_t reg;
+
+    // A lone ecall leaves everything as it was
+    if (0 == transfer->written)
+    {
+        return;
+    }
+    printf(" [");
+    for (reg = 1; reg <= TRANSFER_PC; reg++)
+    {
+        if (transfer->written & (1ull << reg))
+        {
+            printf("%s%s := ", separator, TRANSFER_PC == reg ? "pc" : registerNames[reg]);
+            printValue(transfer->values[reg]);
+            separator = "; ";
+        }
+    }
+    putchar(']');
+}
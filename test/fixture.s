@@ -0,0 +1,139 @@
+# Fixture for run.sh. Assembled with the C, F, A, M and Zbb extensions on,
+# so most of it comes out compressed, and linked at 0x10000
+	.text
+	.globl _start
+_start:
+	addi sp, sp, -16
+	sw ra, 12(sp)
+	jal ra, frame32
+	lw ra, 12(sp)
+	addi sp, sp, 16
+	ret
+
+# The same epilogue with three frame sizes
+frame32:
+	lw ra, 28(sp)
+	lw s0, 24(sp)
+	lw s1, 20(sp)
+	addi sp, sp, 32
+	ret
+frame16:
+	lw ra, 28(sp)
+	lw s0, 24(sp)
+	lw s1, 20(sp)
+	addi sp, sp, 16
+	ret
+frame48:
+	lw ra, 28(sp)
+	lw s0, 24(sp)
+	lw s1, 20(sp)
+	addi sp, sp, 48
+	ret
+
+# Pseudo-instructions
+pseudo:
+	lw ra, 12(sp)
+	li a0, 0
+	li a1, 2047
+	mv a2, a3
+	not a3, a4
+	neg a4, a5
+	seqz a5, a0
+	snez a6, a1
+	sext.b a7, a2
+	addi sp, sp, 16
+	ret
+
+# Both ways out of a branch
+branch:
+	lw ra, 12(sp)
+	beqz a0, 1f
+	mv a1, a2
+1:
+	addi sp, sp, 16
+	ret
+
+# Floating point, atomics and CSRs
+other:
+	lw ra, 12(sp)
+	flw fa0, 8(sp)
+	fmv.x.w a0, fa0
+	amoadd.w a1, a2, (a3)
+	csrr a4, fcsr
+	fence
+	addi sp, sp, 16
+	ret
+
+# JOP: the first one keeps rewriting its jump register
+jop:
+	mv a5, a0
+	lw a5, 0(a0)
+	jr a5
+jop2:
+	lw a0, 8(sp)
+	lw t0, 0(a1)
+	jr t0
+
+# Dispatchers, the second one through a compressed jr
+dispatcher:
+	addi a0, a0, 4
+	lw t0, 0(a0)
+	jr t0
+dispatcher2:
+	addi s0, s0, 12
+	lw a5, 0(s0)
+	jr a5
+
+# Calls through a register
+cop:
+	lw a0, 8(sp)
+	mv a1, s2
+	jalr a5
+cop2:
+	lw a0, 4(sp)
+	jalr t1, 0(t2)
+
+# Syscalls
+exit:
+	lw a0, 4(sp)
+	li a7, 93
+	ecall
+read:
+	lw a7, 8(sp)
+	ecall
+write:
+	li a7, 63
+	mv a0, a1
+	ecall
+
+# Pivots
+pivot:
+	mv sp, a0
+	lw ra, 4(sp)
+	ret
+lift:
+	addi sp, sp, 1024
+	lw ra, 12(sp)
+	ret
+load:
+	lw sp, 8(a1)
+	jr a2
+
+# Register transfers
+transfer:
+	lw ra, 12(sp)
+	lw a0, 8(sp)
+	addi a1, a0, 4
+	sw a0, 0(a2)
+	lw t0, 0(a2)
+	addi sp, sp, 16
+	ret
+
+# Falls through into the next function
+fall:
+	lw ra, 12(sp)
+	lw s0, 8(sp)
+into:
+	addi a0, a0, 1
+	addi sp, sp, 16
+	ret
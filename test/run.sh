@@ -0,0 +1,73 @@
+#!/bin/sh
+# Runs ropv on the fixture and compares its output with expected/NAME.txt.
+# When the riscv32 objdump is installed, the built-in decoder is also
+# checked against it (-o)
+
+cd "$(dirname "$0")" || exit 1
+
+ROPV=../release/ropv
+OBJDUMP=/opt/rv32/bin/riscv32-unknown-linux-gnu-objdump
+failed=0
+
+# check NAME OPTION...
+check()
+{
+    name=$1
+    shift
+
+    if ! "$ROPV" "$@" fixture > "$name.out" 2>&1; then
+        echo "[-] $name: ropv $* failed"
+        failed=1
+    elif ! cmp -s "expected/$name.txt" "$name.out"; then
+        echo "[-] $name: ropv $* differs from expected/$name.txt"
+        diff -u "expected/$name.txt" "$name.out"
+        failed=1
+    fi
+    rm -f "$name.out"
+}
+
+# same OPTION...: the built-in decoder finds what objdump's output gives
+same()
+{
+    if [ ! -x "$OBJDUMP" ]; then
+        return
+    fi
+    "$ROPV" "$@" fixture > native.out 2>&1
+    "$ROPV" -o "$@" fixture > objdump.out 2>&1
+
+    if ! cmp -s native.out objdump.out; then
+        echo "[-] ropv $* differs from ropv -o $*"
+        diff -u objdump.out native.out
+        failed=1
+    fi
+    rm -f native.out objdump.out
+}
+
+check all -a
+check ret -r
+check jop -j
+check sys -s
+check cfi -a -c
+check kernel -a -k
+check backward -a -S backward
+check depth -a -d 2 -J 2
+check cross -a -x
+check branches -a -S backward -b
+check dispatchers -D
+check cop -C
+check syscall -N 93
+check pivots -P
+check frame -a -F
+check transfer -a -T
+
+same -a
+same -r
+same -j
+same -s
+same -a -c
+same -a -k
+
+if [ 0 = "$failed" ]; then
+    echo "[+] All tests passed"
+fi
+exit $failed